@@ -4,9 +4,10 @@ SCRIPT_DIR = os.path.dirname(os.path.abspath(__file__))
 version_path = os.path.join(SCRIPT_DIR, "version.txt")
 __version__ = open(version_path).read()
 
-from .env import ProcgenEnv, ProcgenGym3Env
+from .env import ProcgenEnv, ProcgenGym3Env, read_action_log_options, replay_action_log
+from .trajectory import TrajectoryReader
 from .gym_registration import register_environments
 
 register_environments()
 
-__all__ = ["ProcgenEnv", "ProcgenGym3Env"]
+__all__ = ["ProcgenEnv", "ProcgenGym3Env", "TrajectoryReader", "read_action_log_options", "replay_action_log"]
@@ -1,5 +1,6 @@
 import os
 import random
+import struct
 from typing import Sequence, Optional, List
 
 import gym3
@@ -11,6 +12,18 @@ SCRIPT_DIR = os.path.dirname(os.path.abspath(__file__))
 
 MAX_STATE_SIZE = 2 ** 20
 
+# should match GamePhase and PHASE_HIST_BUCKETS in phase-timer.h
+PHASE_NAMES = ["game_step", "reset", "render", "convert"]
+PHASE_HIST_BUCKETS = 32
+
+# should match RolloutPolicy in vecgame.h
+ROLLOUT_POLICY_DICT = {"random": 0, "constant": 1, "scripted": 2}
+
+# libenv dtype and space enums
+LIBENV_DTYPES = {1: np.uint8, 2: np.int32, 3: np.float32}
+LIBENV_SPACE_OBSERVATION = 1
+LIBENV_SPACE_INFO = 3
+
 ENV_NAMES = [
     "bigfish",
     "bossfight",
@@ -50,6 +63,12 @@ DISTRIBUTION_MODE_DICT = {
     "exploration": 20,
 }
 
+# should match RandGenType in randgen.h
+RAND_GEN_DICT = {
+    "mt19937": 0,
+    "xoshiro128": 1,
+}
+
 
 def create_random_seed():
     rand_seed = random.SystemRandom().randint(0, 2 ** 31 - 1)
@@ -81,7 +100,19 @@ class BaseProcgenEnv(CEnv):
         debug_mode=0,
         resource_root=None,
         num_threads=4,
+        num_groups=1,
+        batch_size=0,
+        thread_affinity=None,
+        partition_envs=False,
+        static_partition=False,
+        spin_wait_us=0,
         render_mode=None,
+        phase_timing=False,
+        tracing=False,
+        trace_path=None,
+        record_path=None,
+        record_chunk_steps=32,
+        action_log_path=None,
     ):
         if resource_root is None:
             resource_root = os.path.join(SCRIPT_DIR, "data", "assets") + os.sep
@@ -117,12 +148,32 @@ class BaseProcgenEnv(CEnv):
                 "debug_mode": debug_mode,
                 "rand_seed": rand_seed,
                 "num_threads": num_threads,
+                "num_groups": num_groups,
+                "batch_size": batch_size,
+                "partition_envs": bool(partition_envs),
+                "static_partition": bool(static_partition),
+                "spin_wait_us": spin_wait_us,
                 "render_human": render_human,
+                "phase_timing": bool(phase_timing),
+                "tracing": bool(tracing),
+                "record_chunk_steps": record_chunk_steps,
                 # these will only be used the first time an environment is created in a process
                 "resource_root": resource_root,
             }
         )
 
+        if thread_affinity is not None:
+            options["thread_affinity"] = thread_affinity
+
+        if trace_path is not None:
+            options["trace_path"] = trace_path
+
+        if record_path is not None:
+            options["record_path"] = record_path
+
+        if action_log_path is not None:
+            options["action_log_path"] = action_log_path
+
         self.options = options
 
         super().__init__(
@@ -133,8 +184,20 @@ class BaseProcgenEnv(CEnv):
                 "int get_state(libenv_env *, int, char *, int);",
                 "void set_state(libenv_env *, int, char *, int);",
                 "void set_environment(libenv_env *, int, char *, int);",
+                "int get_phase_stats(libenv_env *, int, int, int64_t *, int);",
+                "int write_trace(libenv_env *, const char *);",
+                "int replay(libenv_env *, const char *, const int32_t *, int, uint8_t *);",
+                "void observe_group(libenv_env *, int);",
+                "void act_group(libenv_env *, int);",
+                "int observe_ready(libenv_env *, int32_t *);",
+                "void act_ready(libenv_env *, const int32_t *, int);",
+                "void libenv_rollout(libenv_env *, int, int, int, struct libenv_buffers *);",
             ],
         )
+        self.num_threads = num_threads
+        assert num % num_groups == 0, "num must be divisible by num_groups"
+        self.num_groups = num_groups
+        self.batch_size = batch_size
         # don't use the dict space for actions
         self.ac_space = self.ac_space["action"]
 
@@ -154,6 +217,138 @@ class BaseProcgenEnv(CEnv):
             self.call_c_func("set_state", env_idx, state, len(state))
             
 
+    def get_phase_stats(self):
+        """
+        Returns the accumulated phase timings when created with phase_timing=True, as a dict with
+        "envs" and "threads" arrays of shape [n, len(PHASE_NAMES), 2 + PHASE_HIST_BUCKETS], where the
+        last axis holds total nanoseconds, sample count and a log2 nanosecond histogram.
+        """
+        length = len(PHASE_NAMES) * (2 + PHASE_HIST_BUCKETS)
+        buf = self._ffi.new(f"int64_t[{length}]")
+
+        def collect(is_thread, count):
+            result = []
+            for idx in range(count):
+                n = self.call_c_func("get_phase_stats", is_thread, idx, buf, length)
+                assert n == length, "environment was not created with phase_timing=True"
+                result.append(np.frombuffer(self._ffi.buffer(buf), dtype=np.int64).copy())
+            return np.array(result).reshape(count, len(PHASE_NAMES), 2 + PHASE_HIST_BUCKETS)
+
+        return dict(envs=collect(0, self.num), threads=collect(1, max(self.num_threads, 1)))
+
+    def get_group_slice(self, group):
+        group_size = self.num // self.num_groups
+        return slice(group * group_size, (group + 1) * group_size)
+
+    def observe_group(self, group):
+        """
+        Like observe(), but only waits for the envs in the given group, the envs of other groups may
+        still be stepping.  Returns (rew, ob, first) for the envs of the group.
+        """
+        self.call_c_func("observe_group", group)
+        s = self.get_group_slice(group)
+        return self._rew[s].copy(), {k: v[s].copy() for k, v in self._ob.items()}, self._first[s].copy()
+
+    def act_group(self, group, ac):
+        """
+        Like act(), but only steps the envs in the given group, ac holds the actions for those envs.
+        This returns without waiting for the step to complete, so inference on one group can overlap
+        with the stepping of the others.
+        """
+        self._ac["action"][self.get_group_slice(group)] = ac
+        self.call_c_func("act_group", group)
+
+    def observe_ready(self):
+        """
+        Waits until batch_size envs have finished stepping, requires the batch_size option.  Returns
+        (env_ids, rew, ob, first) for those envs, the other envs may still be stepping.  The returned
+        envs are not returned again until they are stepped with act_ready().
+        """
+        assert self.batch_size > 0, "environment was not created with batch_size"
+        env_ids = np.zeros(self.batch_size, dtype=np.int32)
+        self.call_c_func("observe_ready", self._ffi.from_buffer("int32_t[]", env_ids))
+        return env_ids, self._rew[env_ids], {k: v[env_ids] for k, v in self._ob.items()}, self._first[env_ids]
+
+    def act_ready(self, env_ids, ac):
+        """
+        Starts stepping the given envs, usually the ones returned by observe_ready(), ac holds their actions
+        """
+        env_ids = np.ascontiguousarray(env_ids, dtype=np.int32)
+        self._ac["action"][env_ids] = ac
+        self.call_c_func("act_ready", self._ffi.from_buffer("int32_t[]", env_ids), len(env_ids))
+
+    def _get_tensortypes(self, space):
+        n = self.call_c_func("libenv_get_tensortypes", space, self._ffi.NULL)
+        types = self._ffi.new(f"struct libenv_tensortype[{n}]")
+        self.call_c_func("libenv_get_tensortypes", space, types)
+        return [
+            (self._ffi.string(t.name).decode("utf8"), tuple(t.shape[i] for i in range(t.ndim)), LIBENV_DTYPES[t.dtype])
+            for t in types
+        ]
+
+    def rollout(self, num_steps, policy="random", seed=0, actions=None):
+        """
+        Steps every env num_steps times without returning to python, the envs are stepped independently on
+        the stepping threads.  policy is one of "random", "constant" (each env repeats its last action)
+        or "scripted", which takes the actions from an array of shape [num_steps, num] in actions.
+
+        Returns a dict with "ob", "rew", "first", "info" and "ac", indexed by [step, env], where
+        ob and info hold what observe() and get_info() would have returned after each step.
+        """
+        assert policy in ROLLOUT_POLICY_DICT, f"invalid policy {policy}"
+        assert (actions is not None) == (policy == "scripted"), "actions are only used with the scripted policy"
+
+        def alloc(types):
+            return {name: np.zeros((num_steps, self.num) + shape, dtype=dtype) for name, shape, dtype in types}
+
+        ob = alloc(self._get_tensortypes(LIBENV_SPACE_OBSERVATION))
+        info = alloc(self._get_tensortypes(LIBENV_SPACE_INFO))
+        rew = np.zeros((num_steps, self.num), dtype=np.float32)
+        first = np.zeros((num_steps, self.num), dtype=np.uint8)
+        if actions is not None:
+            ac = np.ascontiguousarray(actions, dtype=np.int32)
+            assert ac.shape == (num_steps, self.num)
+        else:
+            ac = np.zeros((num_steps, self.num), dtype=np.int32)
+
+        ob_ptrs = self._ffi.new("void *[]", [self._ffi.from_buffer(v) for v in ob.values()])
+        info_ptrs = self._ffi.new("void *[]", [self._ffi.from_buffer(v) for v in info.values()])
+        ac_ptrs = self._ffi.new("void *[]", [self._ffi.from_buffer(ac)])
+        bufs = self._ffi.new("struct libenv_buffers *")
+        bufs.ob = ob_ptrs
+        bufs.rew = self._ffi.cast("float *", self._ffi.from_buffer(rew))
+        bufs.first = self._ffi.cast("uint8_t *", self._ffi.from_buffer(first))
+        bufs.info = info_ptrs
+        bufs.ac = ac_ptrs
+
+        self.call_c_func("libenv_rollout", num_steps, ROLLOUT_POLICY_DICT[policy], seed, bufs)
+        return dict(ob=ob, rew=rew, first=first, info=info, ac=ac)
+
+    def write_trace(self, path):
+        """
+        Writes the events recorded so far as Chrome trace JSON when created with tracing=True or a
+        trace_path, the file can be opened in chrome://tracing or https://ui.perfetto.dev
+        """
+        assert self.options["tracing"] or "trace_path" in self.options, "environment was not created with tracing=True"
+        ok = self.call_c_func("write_trace", path.encode("utf8"))
+        assert ok, f"failed to write trace to {path}"
+
+    def replay(self, path, render_steps):
+        """
+        Replays an action log on this environment, which must be new and created with the options
+        of the log, see replay_action_log()
+        """
+        steps = np.unique(np.asarray(render_steps, dtype=np.int32))
+        obs = np.zeros((len(steps), self.num, 64, 64, 3), dtype=np.uint8)
+        self.call_c_func(
+            "replay",
+            path.encode("utf8"),
+            self._ffi.from_buffer("int32_t[]", steps),
+            len(steps),
+            self._ffi.from_buffer("uint8_t[]", obs),
+        )
+        return {int(step): ob for step, ob in zip(steps, obs)}
+
     def set_environment(self, params: List[List[int]]):
         '''Sets the parameters controlling the procedurial generation of the environment
 
@@ -246,6 +441,8 @@ class ProcgenGym3Env(BaseProcgenEnv):
         use_generated_assets=False,
         paint_vel_info=False,
         distribution_mode="hard",
+        rand_gen="mt19937",
+        cache_static_layer=True,
         **kwargs,
     ):
         assert (
@@ -265,6 +462,10 @@ class ProcgenGym3Env(BaseProcgenEnv):
         else:
             distribution_mode = DISTRIBUTION_MODE_DICT[distribution_mode]
 
+        assert (
+            rand_gen in RAND_GEN_DICT
+        ), f'"{rand_gen}" is not a valid random number generator.'
+
         options = {
                 "center_agent": bool(center_agent),
                 "use_generated_assets": bool(use_generated_assets),
@@ -273,10 +474,76 @@ class ProcgenGym3Env(BaseProcgenEnv):
                 "use_backgrounds": bool(use_backgrounds),
                 "paint_vel_info": bool(paint_vel_info),
                 "distribution_mode": distribution_mode,
+                "rand_gen_type": RAND_GEN_DICT[rand_gen],
+                "cache_static_layer": bool(cache_static_layer),
             }
         super().__init__(num, env_name, options, **kwargs)
         
         
+# options that only affect how an environment is run, these are not used for replays
+ACTION_LOG_IGNORED_OPTIONS = {
+    "num_actions",
+    "num_threads",
+    "num_groups",
+    "batch_size",
+    "thread_affinity",
+    "partition_envs",
+    "static_partition",
+    "spin_wait_us",
+    "render_human",
+    "phase_timing",
+    "tracing",
+    "trace_path",
+    "record_path",
+    "record_chunk_steps",
+    "action_log_path",
+    "resource_root",
+}
+
+
+def read_action_log_options(path):
+    """
+    Returns the number of environments and the options of an action log written by an environment
+    created with an action_log_path
+    """
+    with open(path, "rb") as f:
+        magic, version, num, num_options = struct.unpack("<8siii", f.read(20))
+        assert magic == b"PGACTLOG", f"{path} is not an action log"
+        assert version == 1, f"unsupported action log version {version}"
+        options = {}
+        for _ in range(num_options):
+            (name_length,) = struct.unpack("<i", f.read(4))
+            name = f.read(name_length).decode("utf8")
+            dtype, count = struct.unpack("<ii", f.read(8))
+            data = np.frombuffer(f.read(count * np.dtype(LIBENV_DTYPES[dtype]).itemsize), dtype=LIBENV_DTYPES[dtype])
+            if dtype == 1 and count == 1:
+                options[name] = bool(data[0])
+            elif dtype == 1:
+                options[name] = data.tobytes().decode("utf8")
+            else:
+                options[name] = data[0].item()
+    return num, options
+
+
+def replay_action_log(path, render_steps, num_threads=4):
+    """
+    Re-simulates the steps of an action log, only rendering the observations of render_steps
+
+    Step 0 is the initial observation and step k the observation after the k-th act().  Returns a
+    dict from each step in render_steps to the observations of all environments at that step.
+    """
+    num, options = read_action_log_options(path)
+    options = {k: v for k, v in options.items() if k not in ACTION_LOG_IGNORED_OPTIONS}
+    kwargs = {
+        name: options.pop(name)
+        for name in ["num_levels", "start_level", "use_sequential_levels", "debug_mode", "rand_seed"]
+        if name in options
+    }
+    env_name = options.pop("env_name")
+    env = BaseProcgenEnv(num, env_name, options, num_threads=num_threads, **kwargs)
+    return env.replay(path, render_steps)
+
+
 class ToBaselinesVecEnv(gym3.ToBaselinesVecEnv):
     metadata = {
         'render.modes': ['human', 'rgb_array'],
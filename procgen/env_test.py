@@ -1,7 +1,12 @@
+import json
+import os
+import platform
 import numpy as np
 import pytest
-from .env import ENV_NAMES
-from procgen import ProcgenGym3Env
+from gym3.libenv import CEnv
+from .builder import build
+from .env import ENV_NAMES, PHASE_NAMES
+from procgen import ProcgenGym3Env, TrajectoryReader, replay_action_log
 
 
 @pytest.mark.parametrize("env_name", ["coinrun", "starpilot"])
@@ -66,4 +71,255 @@ def test_multi_speed(env_name, num_envs, benchmark):
             env.observe()
             step_count += 1
 
-    benchmark(lambda: rollout(1000))
\ No newline at end of file
+    benchmark(lambda: rollout(1000))
+
+@pytest.mark.parametrize("env_name", ["coinrun", "caveflyer"])
+def test_rand_gen(env_name):
+    def first_obs(rand_gen):
+        env = ProcgenGym3Env(
+            num=1, env_name=env_name, num_levels=1, start_level=0, rand_gen=rand_gen
+        )
+        _, obs, _ = env.observe()
+        return obs["rgb"]
+
+    # the generator is deterministic, but the same level seed produces a different level
+    assert np.array_equal(first_obs("xoshiro128"), first_obs("xoshiro128"))
+    assert not np.array_equal(first_obs("xoshiro128"), first_obs("mt19937"))
+
+
+@pytest.mark.parametrize("num_threads", [0, 2])
+def test_phase_timing(num_threads):
+    num_steps = 20
+    env = ProcgenGym3Env(num=4, env_name="coinrun,bigfish", num_threads=num_threads, phase_timing=True)
+    for _ in range(num_steps):
+        env.act(np.zeros(env.num, dtype=np.int32))
+        env.observe()
+        for info in env.get_info():
+            assert info["phase_game_step_ns"] > 0
+            assert info["phase_render_ns"] > 0
+            assert info["phase_convert_ns"] > 0
+    # the restored state is rendered on the calling thread, which only has stats without stepping threads
+    env.set_state(env.get_state())
+
+    stats = env.get_phase_stats()
+    game_step, render = PHASE_NAMES.index("game_step"), PHASE_NAMES.index("render")
+    assert np.all(stats["envs"][:, game_step, 1] == num_steps)
+    assert np.all(stats["envs"][:, render, 1] == num_steps + 2)
+    assert stats["threads"].shape[0] == max(num_threads, 1)
+    assert stats["threads"][:, game_step, 1].sum() == env.num * num_steps
+    caller_renders = env.num if num_threads == 0 else 0
+    assert stats["threads"][:, render, 1].sum() == env.num * (num_steps + 1) + caller_renders
+    # the histogram holds every sample
+    assert np.array_equal(stats["envs"][:, :, 2:].sum(axis=2), stats["envs"][:, :, 1])
+
+def test_trace(tmp_path):
+    env = ProcgenGym3Env(num=4, env_name="coinrun,bigfish", num_threads=2, tracing=True)
+    for _ in range(10):
+        env.act(np.zeros(env.num, dtype=np.int32))
+        env.observe()
+    path = str(tmp_path / "trace.json")
+    env.write_trace(path)
+
+    with open(path) as f:
+        events = json.load(f)["traceEvents"]
+    names = set(e["name"] for e in events)
+    assert {"libenv_act", "libenv_observe", "step", "render"} <= names
+    assert all(e["args"]["game"] in ("coinrun", "bigfish") for e in events if e["name"] == "step")
+
+
+def test_record(tmp_path):
+    path = str(tmp_path / "trajectory.bin")
+    env = ProcgenGym3Env(num=3, env_name="coinrun,bigfish,miner", rand_seed=0, record_path=path, record_chunk_steps=4)
+    rng = np.random.RandomState(0)
+    expected = []
+    for _ in range(10):
+        rew, ob, first = env.observe()
+        ac = rng.randint(0, env.ac_space.eltype.n, size=3)
+        expected.append((ob["rgb"].copy(), rew.copy(), first.copy(), env.get_info(), ac))
+        env.act(ac)
+    env.close()
+
+    reader = TrajectoryReader(path)
+    assert reader.num_chunks == 3
+    data = reader.read()
+    assert data["rgb"].shape == (10, 3, 64, 64, 3)
+    for t, (ob, rew, first, info, ac) in enumerate(expected):
+        assert np.array_equal(data["rgb"][t], ob)
+        assert np.array_equal(data["reward"][t], rew)
+        assert np.array_equal(data["first"][t], first)
+        assert np.array_equal(data["level_seed"][t], [i["level_seed"] for i in info])
+        assert np.array_equal(data["action"][t], ac)
+
+
+def test_action_log(tmp_path):
+    path = str(tmp_path / "actions.log")
+    env = ProcgenGym3Env(num=2, env_name="coinrun", rand_seed=0, action_log_path=path)
+    rng = np.random.RandomState(0)
+    obs = [env.observe()[1]["rgb"].copy()]
+    for t in range(30):
+        if t == 10:
+            env.set_environment([[5, 1, 2], [7, 3, 4]])
+        env.act(rng.randint(0, env.ac_space.eltype.n, size=2))
+        obs.append(env.observe()[1]["rgb"].copy())
+    env.close()
+
+    render_steps = [0, 10, 11, 30]
+    replayed = replay_action_log(path, render_steps)
+    assert sorted(replayed) == render_steps
+    for step in render_steps:
+        assert np.array_equal(replayed[step], obs[step])
+
+
+def test_groups():
+    def make():
+        return ProcgenGym3Env(num=4, env_name="bigfish", rand_seed=0, num_groups=2)
+
+    env = make()
+    group_env = make()
+    rng = np.random.RandomState(0)
+    for _ in range(20):
+        ac = rng.randint(0, env.ac_space.eltype.n, size=4)
+        env.act(ac)
+        group_env.act_group(0, ac[:2])
+        group_env.act_group(1, ac[2:])
+        rew, ob, first = env.observe()
+        for group, s in [(1, slice(2, 4)), (0, slice(0, 2))]:
+            group_rew, group_ob, group_first = group_env.observe_group(group)
+            assert np.array_equal(rew[s], group_rew)
+            assert np.array_equal(ob["rgb"][s], group_ob["rgb"])
+            assert np.array_equal(first[s], group_first)
+
+
+def test_batch_size():
+    env = ProcgenGym3Env(num=8, env_name="bigfish", rand_seed=0, batch_size=3)
+    rng = np.random.RandomState(0)
+    seen = set()
+    for _ in range(20):
+        env_ids, rew, ob, first = env.observe_ready()
+        assert len(env_ids) == 3 and len(set(env_ids)) == 3
+        assert ob["rgb"].shape[0] == 3
+        # waits for the envs still stepping, the returned envs are not stepped until act_ready
+        full_rew, full_ob, full_first = env.observe()
+        assert np.array_equal(rew, full_rew[env_ids])
+        assert np.array_equal(ob["rgb"], full_ob["rgb"][env_ids])
+        assert np.array_equal(first, full_first[env_ids])
+        seen.update(env_ids.tolist())
+        env.act_ready(env_ids, rng.randint(0, env.ac_space.eltype.n, size=3))
+    assert seen <= set(range(8))
+
+
+@pytest.mark.parametrize(
+    "pool_options",
+    [
+        {"partition_envs": True},
+        {"partition_envs": True, "thread_affinity": "0"},
+        {"static_partition": True},
+        {"spin_wait_us": 50},
+    ],
+)
+def test_thread_pool_options(pool_options):
+    def make(**kwargs):
+        return ProcgenGym3Env(num=8, env_name="coinrun,bigfish,miner,starpilot", rand_seed=0, num_threads=2, **kwargs)
+
+    env = make()
+    pool_env = make(**pool_options)
+    rng = np.random.RandomState(0)
+    for _ in range(50):
+        ac = rng.randint(0, env.ac_space.eltype.n, size=env.num)
+        env.act(ac)
+        pool_env.act(ac)
+        rew, ob, first = env.observe()
+        pool_rew, pool_ob, pool_first = pool_env.observe()
+        assert np.array_equal(rew, pool_rew)
+        assert np.array_equal(ob["rgb"], pool_ob["rgb"])
+        assert np.array_equal(first, pool_first)
+
+def test_rollout():
+    def make():
+        return ProcgenGym3Env(num=3, env_name="bigfish", rand_seed=0)
+
+    env = make()
+    rollout_env = make()
+    actions = np.random.RandomState(0).randint(0, env.ac_space.eltype.n, size=(20, 3))
+    result = rollout_env.rollout(20, policy="scripted", actions=actions)
+    for t in range(20):
+        env.act(actions[t])
+        rew, ob, first = env.observe()
+        assert np.array_equal(rew, result["rew"][t])
+        assert np.array_equal(ob["rgb"], result["ob"]["rgb"][t])
+        assert np.array_equal(first, result["first"][t])
+
+    random_result = rollout_env.rollout(5, policy="random", seed=1)
+    assert random_result["ob"]["rgb"].shape == (5, 3, 64, 64, 3)
+
+
+@pytest.mark.parametrize("env_name", ENV_NAMES)
+def test_state_roundtrip(env_name):
+    def make():
+        return ProcgenGym3Env(num=2, env_name=env_name, rand_seed=0)
+
+    env = make()
+    rng = np.random.RandomState(0)
+    for _ in range(50):
+        env.act(rng.randint(0, env.ac_space.eltype.n, size=2))
+
+    restored_env = make()
+    restored_env.set_state(env.get_state())
+    for _ in range(50):
+        ac = rng.randint(0, env.ac_space.eltype.n, size=2)
+        env.act(ac)
+        restored_env.act(ac)
+        rew, ob, first = env.observe()
+        restored_rew, restored_ob, restored_first = restored_env.observe()
+        assert np.array_equal(rew, restored_rew)
+        assert np.array_equal(ob["rgb"], restored_ob["rgb"])
+        assert np.array_equal(first, restored_first)
+    assert env.get_state() == restored_env.get_state()
+
+
+def test_static_layer_cache():
+    def make(cache_static_layer):
+        return ProcgenGym3Env(
+            num=2, env_name="chaser", rand_seed=0, render_mode="rgb_array", cache_static_layer=cache_static_layer
+        )
+
+    env = make(True)
+    uncached_env = make(False)
+    rng = np.random.RandomState(0)
+    total_rew = 0
+    for _ in range(200):
+        # orbs are eaten and levels restart along the way, which changes the cached grid
+        ac = rng.randint(0, env.ac_space.eltype.n, size=2)
+        env.act(ac)
+        uncached_env.act(ac)
+        rew, ob, _ = env.observe()
+        _, uncached_ob, _ = uncached_env.observe()
+        total_rew += rew.sum()
+        assert np.array_equal(ob["rgb"], uncached_ob["rgb"])
+        for info, uncached_info in zip(env.get_info(), uncached_env.get_info()):
+            assert np.array_equal(info["rgb"], uncached_info["rgb"])
+    assert total_rew > 0
+
+
+@pytest.mark.skipif(platform.system() != "Linux", reason="the shared memory client is only built on linux")
+def test_shm_client():
+    if os.path.exists(os.path.join(os.path.dirname(__file__), "data", "prebuilt")):
+        pytest.skip("the shared memory client is not included in the prebuilt package")
+    env = ProcgenGym3Env(num=3, env_name="coinrun,bigfish,miner", rand_seed=0)
+    build_dir = build()
+    shm_env = CEnv(
+        lib_dir=os.path.join(build_dir, "shm-client"),
+        num=env.num,
+        options=dict(env.options, server_path=os.path.join(build_dir, "procgen_server")),
+    )
+    rng = np.random.RandomState(0)
+    for _ in range(50):
+        ac = rng.randint(0, env.ac_space.eltype.n, size=env.num).astype(np.int32)
+        env.act(ac)
+        shm_env.act({"action": ac})
+        rew, ob, first = env.observe()
+        shm_rew, shm_ob, shm_first = shm_env.observe()
+        assert np.array_equal(rew, shm_rew)
+        assert np.array_equal(ob["rgb"], shm_ob["rgb"])
+        assert np.array_equal(first, shm_first)
+    shm_env.close()
@@ -0,0 +1,132 @@
+#include "action-log.h"
+#include "cpp-utils.h"
+#include <cstring>
+
+const size_t ACTION_LOG_BUFFER_SIZE = 1 << 20;
+
+static size_t dtype_size(enum libenv_dtype dtype) {
+    return dtype == LIBENV_DTYPE_UINT8 ? 1 : 4;
+}
+
+ActionLogWriter::ActionLogWriter(const std::string &path, int _num_envs, const std::vector<struct libenv_option> &options) {
+    num_envs = _num_envs;
+    file = fopen(path.c_str(), "wb");
+    if (file == nullptr) {
+        fatal("failed to open action log %s\n", path.c_str());
+    }
+
+    append(ACTION_LOG_MAGIC, sizeof(ACTION_LOG_MAGIC));
+    append_int(ACTION_LOG_VERSION);
+    append_int(num_envs);
+    append_int((int32_t)(options.size()));
+    for (const auto &opt : options) {
+        int32_t name_length = (int32_t)(strlen(opt.name));
+        append_int(name_length);
+        append(opt.name, name_length);
+        append_int(opt.dtype);
+        append_int(opt.count);
+        append(opt.data, opt.count * dtype_size(opt.dtype));
+    }
+    flush();
+}
+
+ActionLogWriter::~ActionLogWriter() {
+    flush();
+    fclose(file);
+}
+
+void ActionLogWriter::write_actions(const std::vector<int32_t> &actions) {
+    fassert((int)(actions.size()) == num_envs);
+    append_int(ActionLogAct);
+    append(actions.data(), actions.size() * sizeof(int32_t));
+    if (buffer.size() >= ACTION_LOG_BUFFER_SIZE) {
+        flush();
+    }
+}
+
+void ActionLogWriter::write_env_data(ActionLogEvent event, int env_idx, const char *data, int length) {
+    append_int(event);
+    append_int(env_idx);
+    append_int(length);
+    append(data, length);
+    flush();
+}
+
+void ActionLogWriter::append(const void *data, size_t size) {
+    auto bytes = (const char *)(data);
+    buffer.insert(buffer.end(), bytes, bytes + size);
+}
+
+void ActionLogWriter::append_int(int32_t value) {
+    append(&value, sizeof(value));
+}
+
+void ActionLogWriter::flush() {
+    if (!buffer.empty() && fwrite(buffer.data(), 1, buffer.size(), file) != buffer.size()) {
+        fatal("failed to write action log\n");
+    }
+    buffer.clear();
+}
+
+ActionLog read_action_log(const std::string &path) {
+    FILE *f = fopen(path.c_str(), "rb");
+    if (f == nullptr) {
+        fatal("failed to open action log %s\n", path.c_str());
+    }
+    std::vector<char> contents;
+    char block[1 << 16];
+    size_t n;
+    while ((n = fread(block, 1, sizeof(block), f)) > 0) {
+        contents.insert(contents.end(), block, block + n);
+    }
+    fclose(f);
+
+    size_t offset = 0;
+    auto read = [&](void *out, size_t size) {
+        if (offset + size > contents.size()) {
+            fatal("truncated action log %s\n", path.c_str());
+        }
+        memcpy(out, &contents[offset], size);
+        offset += size;
+    };
+    auto read_int = [&]() {
+        int32_t value;
+        read(&value, sizeof(value));
+        return value;
+    };
+
+    char magic[sizeof(ACTION_LOG_MAGIC)];
+    read(magic, sizeof(magic));
+    fassert(memcmp(magic, ACTION_LOG_MAGIC, sizeof(magic)) == 0);
+    fassert(read_int() == ACTION_LOG_VERSION);
+
+    ActionLog log;
+    log.num_envs = read_int();
+    int num_options = read_int();
+    for (int i = 0; i < num_options; i++) {
+        offset += read_int();
+        auto dtype = (enum libenv_dtype)(read_int());
+        int count = read_int();
+        offset += count * dtype_size(dtype);
+    }
+
+    while (offset < contents.size()) {
+        ActionLogEntry entry;
+        entry.event = (ActionLogEvent)(read_int());
+        if (entry.event == ActionLogAct) {
+            entry.actions.resize(log.num_envs);
+            read(entry.actions.data(), log.num_envs * sizeof(int32_t));
+            log.num_steps++;
+        } else if (entry.event == ActionLogSetEnvironment || entry.event == ActionLogSetState) {
+            entry.env_idx = read_int();
+            fassert(entry.env_idx >= 0 && entry.env_idx < log.num_envs);
+            entry.data.resize(read_int());
+            read(entry.data.data(), entry.data.size());
+        } else {
+            fatal("invalid action log event %d\n", entry.event);
+        }
+        log.entries.push_back(std::move(entry));
+    }
+
+    return log;
+}
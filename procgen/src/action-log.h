@@ -0,0 +1,78 @@
+#pragma once
+
+/*
+
+Action logs, a compact record of a VecGame run that can be replayed deterministically
+
+The games only depend on their options and the sequence of actions and set_environment and
+set_state calls, so instead of observations a log stores the libenv options the VecGame was
+created with, followed by these calls in order. Replaying the log on a new VecGame created with
+the same options reproduces every step, see VecGame::replay.
+
+File format, all values are little endian int32 unless noted:
+
+    char magic[8]
+    version
+    num_envs
+    num_options
+    options, each made of
+        name_length, char name[name_length]
+        dtype, count, data[count] with the element size of dtype
+    events until the end of the file, each starting with an ActionLogEvent
+        ActionLogAct: action[num_envs]
+        ActionLogSetEnvironment, ActionLogSetState: env_idx, length, char data[length]
+
+*/
+
+#include "libenv.h"
+#include <stdio.h>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+const char ACTION_LOG_MAGIC[8] = {'P', 'G', 'A', 'C', 'T', 'L', 'O', 'G'};
+const int ACTION_LOG_VERSION = 1;
+
+enum ActionLogEvent {
+    ActionLogAct = 0,
+    ActionLogSetEnvironment = 1,
+    ActionLogSetState = 2,
+};
+
+class ActionLogWriter {
+  public:
+    ActionLogWriter(const std::string &path, int _num_envs, const std::vector<struct libenv_option> &options);
+    ~ActionLogWriter();
+
+    void write_actions(const std::vector<int32_t> &actions);
+    // data is the buffer passed to set_environment or set_state
+    void write_env_data(ActionLogEvent event, int env_idx, const char *data, int length);
+
+  private:
+    int num_envs;
+    FILE *file;
+    // events are buffered and written in large blocks
+    std::vector<char> buffer;
+
+    void append(const void *data, size_t size);
+    void append_int(int32_t value);
+    void flush();
+};
+
+struct ActionLogEntry {
+    ActionLogEvent event;
+    // the actions of every env for ActionLogAct, otherwise the env the data is for
+    int env_idx = -1;
+    std::vector<int32_t> actions;
+    std::vector<char> data;
+};
+
+// the options are only needed to create the env to replay on, see procgen/env.py
+struct ActionLog {
+    int num_envs = 0;
+    std::vector<ActionLogEntry> entries;
+    int num_steps = 0;
+};
+
+// calls fatal if the file can't be read
+ActionLog read_action_log(const std::string &path);
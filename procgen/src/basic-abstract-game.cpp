@@ -2,6 +2,7 @@
 #include "resources.h"
 #include "assetgen.h"
 #include "qt-utils.h"
+#include <functional>
 
 const float MAXVTHETA = 15 * PI / 180;
 const float MIXRATEROT = 0.5f;
@@ -12,6 +13,7 @@ const float POS_EPS = -0.001f;
 // When the grid isn't integer aligned, consecutive blocks render with small gaps between them
 // This hack closes the gaps
 const float RENDER_EPS = 0.02f;
+const float BROADPHASE_SLACK = 0.01f;
 
 // objects with type lower than this threshold will be rendered with procgen assets
 // objects with type higher than this threshold will be rendered with colored grid squares
@@ -216,10 +218,18 @@ std::vector<int> BasicAbstractGame::get_cells_with_type(int type) {
 
 void BasicAbstractGame::set_obj(int idx, int elem) {
     grid.set_index(idx, elem);
+
+    if (cache_static_layer) {
+        static_layer_changes.push_back(idx);
+    }
 }
 
 void BasicAbstractGame::set_obj(int x, int y, int elem) {
     grid.set(x, y, elem);
+
+    if (cache_static_layer) {
+        static_layer_changes.push_back(grid.to_index(x, y));
+    }
 }
 
 std::shared_ptr<Entity> BasicAbstractGame::spawn_child(const std::shared_ptr<Entity> &src, int type, float obj_r, bool match_vel) {
@@ -332,10 +342,14 @@ bool BasicAbstractGame::sub_step(const std::shared_ptr<Entity> &obj, float _vx,
     obj->x = nx;
     obj->y = ny;
 
+    if (!is_blocked_by_entities(obj->type)) {
+        return block;
+    }
+
     bool block2 = false;
 
     for (int i = (int)(entities.size()) - 1; i >= 0; i--) {
-        auto m = entities[i];
+        const auto &m = entities[i];
 
         if (m == obj || m->will_erase) {
             continue;
@@ -499,6 +513,10 @@ bool BasicAbstractGame::will_reflect(int src, int target) {
     return false;
 }
 
+bool BasicAbstractGame::is_blocked_by_entities(int type) {
+    return entities_block_movement;
+}
+
 float BasicAbstractGame::get_agent_acceleration_scale() {
     return 1.0;
 }
@@ -716,7 +734,10 @@ void BasicAbstractGame::game_step() {
 
     step_entities(entities);
 
-    for (int i = (int)(entities.size()) - 1; i >= 0; i--) {
+    int num_stepped_entities = (int)(entities.size());
+    bool broadphase_ready = false;
+
+    for (int i = num_stepped_entities - 1; i >= 0; i--) {
         auto ent = entities[i];
 
         if (has_agent_collision(ent)) {
@@ -724,13 +745,32 @@ void BasicAbstractGame::game_step() {
         }
 
         if (ent->collides_with_entities) {
-            for (int j = (int)(entities.size()) - 1; j >= 0; j--) {
-                if (i == j)
-                    continue;
-                auto ent2 = entities[j];
+            int num_entities = (int)(entities.size());
+
+            if (use_collision_broadphase) {
+                if (!broadphase_ready) {
+                    build_collision_broadphase(num_stepped_entities);
+                    broadphase_ready = true;
+                }
+
+                // entities added by handle_collision during this loop are not in the broadphase, they
+                // come first since the entities are visited from the back
+                for (int j = num_entities - 1; j >= num_stepped_entities; j--) {
+                    check_entity_collision(ent, j);
+                }
 
-                if (has_collision(ent, ent2, ent->collision_margin) && !ent->will_erase && !ent2->will_erase) {
-                    handle_collision(ent, ent2);
+                query_collision_broadphase(ent);
+
+                for (int j : broadphase_candidates) {
+                    if (i == j)
+                        continue;
+                    check_entity_collision(ent, j);
+                }
+            } else {
+                for (int j = num_entities - 1; j >= 0; j--) {
+                    if (i == j)
+                        continue;
+                    check_entity_collision(ent, j);
                 }
             }
         }
@@ -745,14 +785,108 @@ void BasicAbstractGame::game_step() {
     step_data.done = step_data.done || is_out_of_bounds(agent);
 }
 
+static void broadphase_cell_range(float pos, float r, int size, int *low, int *high) {
+    // slightly larger than the box so float rounding in has_collision can't miss a pair
+    float slack = BROADPHASE_SLACK + std::max(r, 0.0f);
+    *low = std::min(std::max((int)(floor(pos - slack)), 0), size - 1);
+    *high = std::min(std::max((int)(floor(pos + slack)), 0), size - 1);
+}
+
+void BasicAbstractGame::check_entity_collision(const std::shared_ptr<Entity> &ent, int j) {
+    const auto &ent2 = entities[j];
+
+    if (has_collision(ent, ent2, ent->collision_margin) && !ent->will_erase && !ent2->will_erase) {
+        // handle_collision may add entities, which can move the one entities[j] points to
+        auto target = ent2;
+        handle_collision(ent, target);
+    }
+}
+
+void BasicAbstractGame::build_collision_broadphase(int num_entities) {
+    int num_cells = main_width * main_height;
+
+    broadphase_offsets.assign(num_cells + 1, 0);
+
+    // entities are binned by the cells their bounding box overlaps, clamped to the world, so two
+    // overlapping boxes share at least one cell
+    auto for_each_cell = [&](int i, auto &&fn) {
+        const auto &e = entities[i];
+        int min_x, max_x, min_y, max_y;
+        broadphase_cell_range(e->x, e->rx, main_width, &min_x, &max_x);
+        broadphase_cell_range(e->y, e->ry, main_height, &min_y, &max_y);
+
+        for (int y = min_y; y <= max_y; y++) {
+            for (int x = min_x; x <= max_x; x++) {
+                fn(y * main_width + x);
+            }
+        }
+    };
+
+    for (int i = 0; i < num_entities; i++) {
+        for_each_cell(i, [&](int cell) { broadphase_offsets[cell + 1]++; });
+    }
+
+    for (int cell = 0; cell < num_cells; cell++) {
+        broadphase_offsets[cell + 1] += broadphase_offsets[cell];
+    }
+
+    broadphase_entities.resize(broadphase_offsets[num_cells]);
+    broadphase_fill.assign(broadphase_offsets.begin(), broadphase_offsets.end() - 1);
+
+    for (int i = 0; i < num_entities; i++) {
+        for_each_cell(i, [&](int cell) { broadphase_entities[broadphase_fill[cell]++] = i; });
+    }
+
+    broadphase_marks.assign(num_entities, 0);
+    broadphase_query_id = 0;
+}
+
+void BasicAbstractGame::query_collision_broadphase(const std::shared_ptr<Entity> &ent) {
+    broadphase_candidates.clear();
+    broadphase_query_id++;
+
+    int min_x, max_x, min_y, max_y;
+    broadphase_cell_range(ent->x, ent->rx + ent->collision_margin, main_width, &min_x, &max_x);
+    broadphase_cell_range(ent->y, ent->ry + ent->collision_margin, main_height, &min_y, &max_y);
+
+    for (int y = min_y; y <= max_y; y++) {
+        for (int x = min_x; x <= max_x; x++) {
+            int cell = y * main_width + x;
+
+            for (int k = broadphase_offsets[cell]; k < broadphase_offsets[cell + 1]; k++) {
+                int j = broadphase_entities[k];
+
+                if (broadphase_marks[j] != broadphase_query_id) {
+                    broadphase_marks[j] = broadphase_query_id;
+                    broadphase_candidates.push_back(j);
+                }
+            }
+        }
+    }
+
+    // same order as a full scan
+    std::sort(broadphase_candidates.begin(), broadphase_candidates.end(), std::greater<int>());
+}
+
 void BasicAbstractGame::erase_if_needed() {
-    for (int i = (int)(entities.size()) - 1; i >= 0; i--) {
-        auto e = entities[i];
+    // a stable compaction, erasing one entity at a time is quadratic when many expire together
+    size_t num_kept = 0;
+
+    for (size_t i = 0; i < entities.size(); i++) {
+        const auto &e = entities[i];
 
         if (e->will_erase || (e->auto_erase && is_out_of_bounds(e))) {
-            entities.erase(entities.begin() + i);
+            continue;
+        }
+
+        if (num_kept != i) {
+            entities[num_kept] = std::move(entities[i]);
         }
+
+        num_kept++;
     }
+
+    entities.resize(num_kept);
 }
 
 void BasicAbstractGame::game_reset() {
@@ -764,6 +898,9 @@ void BasicAbstractGame::game_reset() {
     grid_size = main_width * main_height;
     grid.resize(main_width, main_height);
 
+    static_layer_epoch++;
+    static_layer_changes.clear();
+
     background_index = rand_gen.randn((int)(main_bg_images_ptr->size()));
 
     AssetGen bggen(&rand_gen);
@@ -918,7 +1055,25 @@ void BasicAbstractGame::draw_grid_obj(QPainter &p, const QRectF &rect, int type,
     p.fillRect(rect, color_for_type(type, theme));
 }
 
-void BasicAbstractGame::draw_foreground(QPainter &p, const QRect &rect) {
+void BasicAbstractGame::draw_grid(QPainter &p, int low_x, int high_x, int low_y, int high_y) {
+    for (int x = low_x; x <= high_x; x++) {
+        for (int y = low_y; y <= high_y; y++) {
+            int type = get_obj(x, y);
+
+            if (type == INVALID_OBJ) {
+                continue;
+            }
+
+            int theme = theme_for_grid_obj(type);
+
+            QRectF r2 = get_screen_rect(x, y + 1, 1, 1, RENDER_EPS);
+
+            draw_image(p, r2, 0, false, type, theme, 1.0, 0.0);
+        }
+    }
+}
+
+void BasicAbstractGame::draw_foreground(QPainter &p, const QRect &rect, bool draw_grid_objs) {
     prepare_for_drawing(rect.height());
 
     draw_entities(p, entities, -1);
@@ -938,20 +1093,8 @@ void BasicAbstractGame::draw_foreground(QPainter &p, const QRect &rect) {
         high_y = main_height - 1;
     }
 
-    for (int x = low_x; x <= high_x; x++) {
-        for (int y = low_y; y <= high_y; y++) {
-            int type = get_obj(x, y);
-
-            if (type == INVALID_OBJ) {
-                continue;
-            }
-
-            int theme = theme_for_grid_obj(type);
-
-            QRectF r2 = get_screen_rect(x, y + 1, 1, 1, RENDER_EPS);
-
-            draw_image(p, r2, 0, false, type, theme, 1.0, 0.0);
-        }
+    if (draw_grid_objs) {
+        draw_grid(p, low_x, high_x, low_y, high_y);
     }
 
     draw_entities(p, entities, 0);
@@ -1006,9 +1149,66 @@ void BasicAbstractGame::draw_background(QPainter &p, const QRect &rect) {
     }
 }
 
+void BasicAbstractGame::draw_static_layer(QPainter &p, const QRect &rect) {
+    StaticLayer *layer = nullptr;
+
+    for (auto &l : static_layers) {
+        if (l.image.size() == rect.size() && l.render_hints == p.renderHints()) {
+            layer = &l;
+        }
+    }
+
+    if (layer == nullptr) {
+        static_layers.emplace_back();
+        layer = &static_layers.back();
+        layer->image = QImage(rect.width(), rect.height(), QImage::Format_RGB32);
+        layer->render_hints = p.renderHints();
+    }
+
+    QRect layer_rect(0, 0, rect.width(), rect.height());
+    QPainter lp(&layer->image);
+    lp.setRenderHints(layer->render_hints);
+
+    if (layer->epoch != static_layer_epoch) {
+        draw_background(lp, layer_rect);
+        draw_grid(lp, 0, main_width - 1, 0, main_height - 1);
+        layer->epoch = static_layer_epoch;
+    } else if (layer->num_applied_changes < static_layer_changes.size()) {
+        prepare_for_drawing(rect.height());
+
+        for (size_t i = layer->num_applied_changes; i < static_layer_changes.size(); i++) {
+            int x, y;
+            to_grid_xy(static_layer_changes[i], &x, &y);
+
+            // repaint every pixel the cell can touch in the same order as a full redraw, the
+            // neighboring cells are included since their rects overlap this one by RENDER_EPS
+            lp.save();
+            lp.setClipRect(get_screen_rect(x, y + 1, 1, 1, RENDER_EPS).toAlignedRect());
+            draw_background(lp, layer_rect);
+            draw_grid(lp, x - 1, x + 1, y - 1, y + 1);
+            lp.restore();
+        }
+    }
+
+    layer->num_applied_changes = static_layer_changes.size();
+    lp.end();
+
+    p.drawImage(rect.topLeft(), layer->image);
+}
+
 void BasicAbstractGame::game_draw(QPainter &p, const QRect &rect) {
-    draw_background(p, rect);
-    draw_foreground(p, rect);
+    if (cache_static_layer && options.cache_static_layer && !options.center_agent) {
+        // render_z -1 entities belong under the grid, which the cached layer has already drawn
+        for (const auto &ent : entities) {
+            fassert(ent->render_z != -1);
+        }
+
+        draw_static_layer(p, rect);
+        draw_foreground(p, rect, false);
+    } else {
+        draw_background(p, rect);
+        draw_foreground(p, rect);
+    }
 }
 
 void BasicAbstractGame::match_aspect_ratio(const std::shared_ptr<Entity> &ent, bool match_width) {
@@ -1229,6 +1429,9 @@ void BasicAbstractGame::deserialize(ReadBuffer *b) {
 
     read_entities(b, entities);
 
+    static_layer_epoch++;
+    static_layer_changes.clear();
+
     int agent_idx = find_entity_index(PLAYER);
     fassert(agent_idx >= 0);
     agent = entities[agent_idx];
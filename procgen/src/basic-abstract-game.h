@@ -34,6 +34,9 @@ class BasicAbstractGame : public Game {
     virtual bool is_blocked(const std::shared_ptr<Entity> &src, int target, bool is_horizontal);
     virtual bool is_blocked_ents(const std::shared_ptr<Entity> &src, const std::shared_ptr<Entity> &target, bool is_horizontal);
     virtual bool will_reflect(int src, int target);
+    // false for entity types that is_blocked_ents and will_reflect never hold for, so sub_step can
+    // skip testing them against every other entity
+    virtual bool is_blocked_by_entities(int type);
     virtual void handle_agent_collision(const std::shared_ptr<Entity> &obj);
     virtual void handle_grid_collision(const std::shared_ptr<Entity> &obj, int type, int i, int j);
     virtual void handle_collision(const std::shared_ptr<Entity> &src, const std::shared_ptr<Entity> &target);
@@ -102,7 +105,8 @@ class BasicAbstractGame : public Game {
     QRectF get_abs_rect(float x, float y, float dx, float dy);
     QRectF get_object_rect(const std::shared_ptr<Entity> &obj);
 
-    void draw_foreground(QPainter &p, const QRect &rect);
+    // draw_grid_objs is false when the grid comes from the static layer
+    void draw_foreground(QPainter &p, const QRect &rect, bool draw_grid_objs = true);
 
     void step_entities(const std::vector<std::shared_ptr<Entity>> &given);
 
@@ -143,9 +147,22 @@ class BasicAbstractGame : public Game {
 
     bool random_agent_start = true;
     bool has_useful_vel_info = false;
+    // draw the background and grid from a cached image that is only redrawn around cells changed
+    // with set_obj, for games with a fixed camera, a static background and no render_z -1 entities
+    bool cache_static_layer = false;
+    // find the entities a collides_with_entities entity may touch with a uniform grid instead of
+    // testing every entity, only valid if handle_agent_collision and handle_collision don't move or
+    // resize entities
+    bool use_collision_broadphase = false;
+    // false if is_blocked_ents and will_reflect never hold for an entity moved by sub_step, the
+    // default for is_blocked_by_entities
+    bool entities_block_movement = true;
     int step_rand_int = 0;
 
     RandGen asset_rand_gen;
+    // reused by level generation so sampling with RandGen doesn't allocate on every reset
+    std::vector<int> chosen_idxs;
+    std::vector<int> choose_scratch;
 
     int main_width = 0;
     int main_height = 0;
@@ -159,16 +176,49 @@ class BasicAbstractGame : public Game {
     float min_visibility = 0.0f;
 
   private:
+    // RoomGenerator works on the raw grid to avoid per-cell bounds checks during level generation
+    friend class RoomGenerator;
+
     Grid<int> grid;
 
+    struct StaticLayer {
+        QImage image;
+        QPainter::RenderHints render_hints;
+        int epoch = -1;
+        size_t num_applied_changes = 0;
+    };
+
+    // one layer per render size, since the observation and the human render may alternate
+    std::vector<StaticLayer> static_layers;
+    // bumped whenever the whole grid may have changed, which invalidates every layer
+    int static_layer_epoch = 0;
+    // cells passed to set_obj since the last epoch change
+    std::vector<int> static_layer_changes;
+
+    // the entity indices in each cell, cell c has broadphase_entities[broadphase_offsets[c]] up to
+    // broadphase_entities[broadphase_offsets[c + 1]]
+    std::vector<int> broadphase_offsets;
+    std::vector<int> broadphase_entities;
+    std::vector<int> broadphase_fill;
+    // broadphase_marks[i] == broadphase_query_id if entity i is already a candidate of the current query
+    std::vector<int> broadphase_marks;
+    int broadphase_query_id = 0;
+    std::vector<int> broadphase_candidates;
+
     QImage *lookup_asset(int img_idx, bool is_reflected = false);
     void initialize_asset_if_necessary(int img_idx);
     void prepare_for_drawing(float rect_height);
     void draw_background(QPainter &p, const QRect &rect);
+    void draw_grid(QPainter &p, int low_x, int high_x, int low_y, int high_y);
+    void draw_static_layer(QPainter &p, const QRect &rect);
     void draw_entity(QPainter &p, const std::shared_ptr<Entity> &to_draw);
     void draw_entities(QPainter &p, const std::vector<std::shared_ptr<Entity>> &to_draw, int render_z = 0);
     void draw_image(QPainter &p, QRectF &rect, float rotation, bool is_reflected, int img_idx, int theme, float alpha, float tile_ratio);
 
+    void check_entity_collision(const std::shared_ptr<Entity> &ent, int j);
+    void build_collision_broadphase(int num_entities);
+    void query_collision_broadphase(const std::shared_ptr<Entity> &ent);
+
     bool sub_step(const std::shared_ptr<Entity> &obj, float _vx, float _vy, int depth);
     bool should_erase(const std::shared_ptr<Entity> &e1);
 };
@@ -3,7 +3,7 @@
 #include "vecoptions.h"
 
 // this should be updated whenever the state format or environments may have changed
-const int SERIALIZE_VERSION = 0;
+const int SERIALIZE_VERSION = 2;
 
 void bgr32_to_rgb888(void *dst_rgb888, void *src_bgr32, int w, int h) {
     uint8_t *src = (uint8_t *)src_bgr32;
@@ -48,11 +48,19 @@ void Game::parse_options(std::string name, VecOptions opts) {
     opts.consume_bool("use_backgrounds", &options.use_backgrounds);
     opts.consume_bool("center_agent", &options.center_agent);
     opts.consume_bool("use_sequential_levels", &options.use_sequential_levels);
+    opts.consume_bool("cache_static_layer", &options.cache_static_layer);
 
     int dist_mode = EasyMode;
     opts.consume_int("distribution_mode", &dist_mode);
     options.distribution_mode = static_cast<DistributionMode>(dist_mode);
 
+    // the asset generator keeps using the default generator so that generated assets don't change
+    int rand_gen_type = RandGenMT19937;
+    opts.consume_int("rand_gen_type", &rand_gen_type);
+    options.rand_gen_type = static_cast<RandGenType>(rand_gen_type);
+    level_seed_rand_gen.set_type(options.rand_gen_type);
+    rand_gen.set_type(options.rand_gen_type);
+
     if (options.distribution_mode == EasyMode) {
         fassert(name != "coinrun_old");
     } else if (options.distribution_mode == HardMode) {
@@ -110,8 +118,12 @@ void Game::reset() {
         step_data.level_complete = false;
     }
 
-    rand_gen.seed(current_level_seed);
-    game_reset();
+    {
+        TraceScope trace(current_trace_buffer(), "reset", game_n, game_name.c_str());
+        PhaseTimer timer(phase_stats.get(), thread_phase_stats, PhaseReset);
+        rand_gen.seed(current_level_seed);
+        game_reset();
+    }
 
     cur_time = 0;
     total_reward = 0;
@@ -131,7 +143,11 @@ void Game::step() {
     step_data.reward = 0;
     step_data.done = false;
     step_data.level_complete = false;
-    game_step();
+
+    {
+        PhaseTimer timer(phase_stats.get(), thread_phase_stats, PhaseGameStep);
+        game_step();
+    }
 
     step_data.done = step_data.done || will_force_reset || (cur_time >= timeout);
     total_reward += step_data.reward;
@@ -157,18 +173,40 @@ void Game::step() {
 }
 
 void Game::observe() {
-    render_to_buf(render_buf, RES_W, RES_H, false);
-    bgr32_to_rgb888(obs_bufs[0], render_buf, RES_W, RES_H);
+    if (render_enabled) {
+        TraceScope trace(current_trace_buffer(), "render", game_n, game_name.c_str());
+
+        {
+            PhaseTimer timer(phase_stats.get(), thread_phase_stats, PhaseRender);
+            render_to_buf(render_buf, RES_W, RES_H, false);
+        }
+
+        {
+            PhaseTimer timer(phase_stats.get(), thread_phase_stats, PhaseConvert);
+            bgr32_to_rgb888(obs_bufs[0], render_buf, RES_W, RES_H);
+        }
+    }
+
     *reward_ptr = step_data.reward;
     *first_ptr = (uint8_t)step_data.done;
     *(int32_t *)(info_bufs[info_name_to_offset.at("prev_level_seed")]) = (int32_t)(prev_level_seed);
     *(uint8_t *)(info_bufs[info_name_to_offset.at("prev_level_complete")]) = (uint8_t)(step_data.level_complete);
     *(int32_t *)(info_bufs[info_name_to_offset.at("level_seed")]) = (int32_t)(current_level_seed);
+
+    if (phase_stats != nullptr) {
+        for (int p = 0; p < NUM_PHASES; p++) {
+            *(int32_t *)(info_bufs[info_name_to_offset.at(PHASE_INFO_NAMES[p])]) = (int32_t)(std::min(phase_stats->last_ns[p], (int64_t)(INT32_MAX)));
+            phase_stats->last_ns[p] = 0;
+        }
+    }
 }
 
 void Game::game_init() {
 }
 
+void Game::restore_derived_state() {
+}
+
 void Game::serialize(WriteBuffer *b) {
     b->write_int(SERIALIZE_VERSION);
     
@@ -183,6 +221,7 @@ void Game::serialize(WriteBuffer *b) {
     b->write_int(options.debug_mode);
     b->write_int(options.distribution_mode);
     b->write_int(options.use_sequential_levels);
+    b->write_int(options.rand_gen_type);
 
     b->write_int(options.use_easy_jump);
     b->write_int(options.plain_assets);
@@ -243,6 +282,7 @@ void Game::deserialize(ReadBuffer *b) {
     options.debug_mode = b->read_int();
     options.distribution_mode = DistributionMode(b->read_int());
     options.use_sequential_levels = b->read_int();
+    options.rand_gen_type = RandGenType(b->read_int());
 
     options.use_easy_jump = b->read_int();
     options.plain_assets = b->read_int();
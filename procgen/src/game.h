@@ -17,6 +17,8 @@ Base class used for all games, all games must inherit from this
 #include "object-ids.h"
 #include "game-registry.h"
 #include "buffer.h"
+#include "phase-timer.h"
+#include "trace.h"
 
 // We want all games to have same observation space. So all these
 // constants here related to observation space are constants forever.
@@ -52,6 +54,8 @@ struct GameOptions {
     int debug_mode = 0;
     DistributionMode distribution_mode = HardMode;
     bool use_sequential_levels = false;
+    RandGenType rand_gen_type = RandGenMT19937;
+    bool cache_static_layer = true;
 
     // coinrun_old
     bool use_easy_jump = false;
@@ -99,6 +103,8 @@ class Game {
     int cur_time = 0;
 
     bool is_waiting_for_step = false;
+    // when false observe only writes the reward, first and info buffers, used by VecGame::replay
+    bool render_enabled = true;
 
     // pointers to buffers
     int32_t *action_ptr;
@@ -107,6 +113,11 @@ class Game {
     float *reward_ptr = nullptr;
     uint8_t *first_ptr = nullptr;
 
+    // only allocated when the phase_timing option is set
+    std::unique_ptr<PhaseStats> phase_stats;
+    // stats of the thread currently running this game, owned by VecGame
+    PhaseStats *thread_phase_stats = nullptr;
+
     Game(std::string name);
     void step();
     void reset();
@@ -121,6 +132,8 @@ class Game {
     virtual void game_draw(QPainter &p, const QRect &rect) = 0;
     virtual void serialize(WriteBuffer *b);
     virtual void deserialize(ReadBuffer *b);
+    // rebuilds the state that serialize leaves out because it can be recomputed, called after deserialize
+    virtual void restore_derived_state();
     virtual void set_environment(ReadBuffer *b) = 0;
 
   private:
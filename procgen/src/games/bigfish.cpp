@@ -26,6 +26,9 @@ class BigFish : public BasicAbstractGame {
 
         main_width = 20;
         main_height = 20;
+
+        // fish never block the agent, they are only eaten or eat it
+        entities_block_movement = false;
     }
 
     void load_background_images() override {
@@ -67,6 +67,8 @@ class BossfightGame : public BasicAbstractGame {
 
         mixrate = .5;
         maxspeed = 0.85f;
+        // the collision handlers change velocities, types and flags but never positions or sizes
+        use_collision_broadphase = true;
     }
 
     void load_background_images() override {
@@ -159,7 +159,7 @@ class CaveFlyerGame : public BasicAbstractGame {
             room_manager->update();
         }
 
-        std::set<int> best_room;
+        std::vector<int> best_room;
         room_manager->find_best_room(best_room);
         fassert(best_room.size() > 0);
 
@@ -174,9 +174,9 @@ class CaveFlyerGame : public BasicAbstractGame {
             free_cells.push_back(i);
         }
 
-        std::vector<int> selected_idxs = rand_gen.simple_choose((int)(free_cells.size()), 2);
-        int agent_cell = free_cells[selected_idxs[0]];
-        int goal_cell = free_cells[selected_idxs[1]];
+        rand_gen.simple_choose((int)(free_cells.size()), 2, chosen_idxs, choose_scratch);
+        int agent_cell = free_cells[chosen_idxs[0]];
+        int goal_cell = free_cells[chosen_idxs[1]];
 
         agent->x = (agent_cell % main_width) + .5;
         agent->y = (agent_cell / main_width) + .5;
@@ -190,8 +190,7 @@ class CaveFlyerGame : public BasicAbstractGame {
         bool should_prune = options.distribution_mode != MemoryMode;
 
         if (should_prune) {
-            std::set<int> wide_path;
-            wide_path.insert(goal_path.begin(), goal_path.end());
+            std::vector<int> wide_path = goal_path;
             room_manager->expand_room(wide_path, 4);
 
             for (int i = 0; i < grid_size; i++) {
@@ -228,10 +227,10 @@ class CaveFlyerGame : public BasicAbstractGame {
         int chunk_size = ((int)(free_cells.size()) / 80);
         int num_objs = 3 * chunk_size;
 
-        std::vector<int> obstacle_idxs = rand_gen.simple_choose((int)(free_cells.size()), num_objs);
+        rand_gen.simple_choose((int)(free_cells.size()), num_objs, chosen_idxs, choose_scratch);
 
         for (int i = 0; i < num_objs; i++) {
-            int val = free_cells[obstacle_idxs[i]];
+            int val = free_cells[chosen_idxs[i]];
 
             if (i < chunk_size) {
                 auto e = spawn_entity_at_idx(val, .5, OBSTACLE);
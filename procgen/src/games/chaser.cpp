@@ -27,6 +27,10 @@ class ChaserGame : public BasicAbstractGame {
     std::shared_ptr<MazeGen> maze_gen;
     std::vector<int> free_cells;
     std::vector<bool> is_space_vec;
+    // the space neighbors of every cell, in the order get_adjacent returns them, cell i has
+    // adj_cells[adj_offsets[i]] up to adj_cells[adj_offsets[i + 1]]
+    std::vector<int> adj_offsets;
+    std::vector<int> adj_cells;
     int eat_timeout = 0;
     int egg_timeout = 0;
     int eat_time = 0;
@@ -45,6 +49,8 @@ class ChaserGame : public BasicAbstractGame {
 
         maze_gen = nullptr;
         has_useful_vel_info = false;
+        // the maze and the orbs only change when an orb is collected
+        cache_static_layer = true;
     }
 
     void load_background_images() override {
@@ -205,10 +211,10 @@ class ChaserGame : public BasicAbstractGame {
 
         for (int i = 0; i < num_quadrants; i++) {
             int num_orbs = orbs_for_quadrant[i];
-            std::vector<int> quadrant = quadrants[i];
-            std::vector<int> selected_idxs = rand_gen.simple_choose((int)(quadrant.size()), num_orbs);
+            const std::vector<int> &quadrant = quadrants[i];
+            rand_gen.simple_choose((int)(quadrant.size()), num_orbs, chosen_idxs, choose_scratch);
 
-            for (int j : selected_idxs) {
+            for (int j : chosen_idxs) {
                 int cell = quadrant[j];
                 spawn_entity_at_idx(cell, 0.4f, LARGE_ORB);
                 set_obj(cell, MARKER);
@@ -216,16 +222,16 @@ class ChaserGame : public BasicAbstractGame {
         }
 
         free_cells = get_cells_with_type(SPACE);
-        std::vector<int> selected_idxs = rand_gen.simple_choose((int)(free_cells.size()), 1 + total_enemies);
+        rand_gen.simple_choose((int)(free_cells.size()), 1 + total_enemies, chosen_idxs, choose_scratch);
 
-        int start_idx = selected_idxs[0];
+        int start_idx = chosen_idxs[0];
         int start = free_cells[start_idx];
 
         agent->x = (start % maze_dim) + .5;
         agent->y = (start / maze_dim) + .5;
 
         for (int i = 0; i < total_enemies; i++) {
-            int cell = free_cells[selected_idxs[i + 1]];
+            int cell = free_cells[chosen_idxs[i + 1]];
             set_obj(cell, MARKER);
             spawn_egg(cell);
         }
@@ -243,6 +249,12 @@ class ChaserGame : public BasicAbstractGame {
             set_obj(cell, SPACE);
         }
 
+        restore_derived_state();
+    }
+
+    // the maze walls never change after game_reset, so everything that depends only on them is
+    // recomputed from the grid rather than serialized
+    void restore_derived_state() override {
         free_cells.clear();
         is_space_vec.clear();
 
@@ -255,6 +267,8 @@ class ChaserGame : public BasicAbstractGame {
 
             is_space_vec.push_back(is_space);
         }
+
+        build_adjacency();
     }
 
     bool can_eat_enemies() {
@@ -266,10 +280,6 @@ class ChaserGame : public BasicAbstractGame {
         egg->health = egg_timeout;
     }
 
-    int manhattan_dist(int a, int b) {
-        return abs((a % main_width) - (b % main_width)) + abs((a / main_width) - (b / main_width));
-    }
-
     void get_adjacent(int idx, std::vector<int> &neighbors) {
         int x = idx % main_width;
         int y = idx / main_width;
@@ -290,6 +300,26 @@ class ChaserGame : public BasicAbstractGame {
         }
     }
 
+    void build_adjacency() {
+        adj_offsets.clear();
+        adj_cells.clear();
+        std::vector<int> neighbors;
+
+        for (int i = 0; i < grid_size; i++) {
+            adj_offsets.push_back((int)(adj_cells.size()));
+            neighbors.clear();
+            get_adjacent(i, neighbors);
+
+            for (int adj : neighbors) {
+                if (is_space_vec[adj]) {
+                    adj_cells.push_back(adj);
+                }
+            }
+        }
+
+        adj_offsets.push_back((int)(adj_cells.size()));
+    }
+
     void game_step() override {
         BasicAbstractGame::game_step();
 
@@ -298,6 +328,11 @@ class ChaserGame : public BasicAbstractGame {
 
         float default_enemy_speed = .5;
         float vscale = can_eat_enemies() ? (default_enemy_speed * .5) : default_enemy_speed;
+        int dist_scale = can_eat_enemies() ? -1 : 1;
+
+        int agent_idx = to_grid_idx(agent->x, agent->y);
+        int agent_x = agent_idx % main_width;
+        int agent_y = agent_idx / main_width;
 
         for (int j = (int)(entities.size()) - 1; j >= 0; j--) {
             auto ent = entities[j];
@@ -319,42 +354,40 @@ class ChaserGame : public BasicAbstractGame {
                 float x = ent->x - .5;
                 float y = ent->y - .5;
 
-                int dist_scale = can_eat_enemies() ? -1 : 1;
-
                 int enemy_idx = to_grid_idx(x, y);
-                int agent_idx = to_grid_idx(agent->x, agent->y);
 
                 bool is_at_junction = fabs(x - round(x)) + fabs(y - round(y)) < .01;
                 bool be_agressive = step_rand_int % 2 == 0;
 
                 if ((ent->vx == 0 && ent->vy == 0) || is_at_junction) {
-                    std::vector<int> adj_elems;
-                    std::vector<int> space_neighbors;
+                    // a cell has at most 4 neighbors
+                    int space_neighbors[4];
+                    int num_space_neighbors = 0;
                     int prev_idx = to_grid_idx(x - sign(ent->vx), y - sign(ent->vy));
-                    get_adjacent(enemy_idx, adj_elems);
 
                     int min_dist = 2 * main_width;
 
-                    for (int adj : adj_elems) {
-                        if (is_space_vec[adj] && adj != prev_idx) {
-                            int md = manhattan_dist(adj, agent_idx) * dist_scale;
+                    for (int k = adj_offsets[enemy_idx]; k < adj_offsets[enemy_idx + 1]; k++) {
+                        int adj = adj_cells[k];
+
+                        if (adj != prev_idx) {
+                            int md = (abs((adj % main_width) - agent_x) + abs((adj / main_width) - agent_y)) * dist_scale;
 
                             if (be_agressive) {
                                 if (md < min_dist) {
                                     min_dist = md;
-                                    space_neighbors.clear();
-                                    space_neighbors.push_back(adj);
+                                    num_space_neighbors = 0;
+                                    space_neighbors[num_space_neighbors++] = adj;
                                 } else if (md == min_dist) {
-                                    space_neighbors.push_back(adj);
+                                    space_neighbors[num_space_neighbors++] = adj;
                                 }
                             } else {
-                                space_neighbors.push_back(adj);
+                                space_neighbors[num_space_neighbors++] = adj;
                             }
                         }
                     }
 
-                    int neighbor_idx = step_rand_int % space_neighbors.size();
-                    int neighbor = space_neighbors[neighbor_idx];
+                    int neighbor = space_neighbors[step_rand_int % num_space_neighbors];
 
                     int nx = neighbor % main_width;
                     int ny = neighbor / main_width;
@@ -370,7 +403,7 @@ class ChaserGame : public BasicAbstractGame {
             spawn_egg(free_cells[selected_idx]);
         }
 
-        int agent_idx = get_agent_index();
+        agent_idx = get_agent_index();
 
         if (get_obj(agent_idx) == ORB) {
             set_obj(agent_idx, SPACE);
@@ -387,8 +420,6 @@ class ChaserGame : public BasicAbstractGame {
 
     void serialize(WriteBuffer *b) override {
         BasicAbstractGame::serialize(b);
-        b->write_vector_int(free_cells);
-        b->write_vector_bool(is_space_vec);
         b->write_int(eat_timeout);
         b->write_int(egg_timeout);
         b->write_int(eat_time);
@@ -400,8 +431,6 @@ class ChaserGame : public BasicAbstractGame {
 
     void deserialize(ReadBuffer *b) override {
         BasicAbstractGame::deserialize(b);
-        free_cells = b->read_vector_int();
-        is_space_vec = b->read_vector_bool();
         eat_timeout = b->read_int();
         egg_timeout = b->read_int();
         eat_time = b->read_int();
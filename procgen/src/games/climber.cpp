@@ -39,6 +39,8 @@ class Climber : public BasicAbstractGame {
     Climber()
         : BasicAbstractGame(NAME) {
         out_of_bounds_object = WALL_MID;
+        // only grid walls block or reflect, enemies and coins never stop anything they touch
+        entities_block_movement = false;
     }
 
     void load_background_images() override {
@@ -99,6 +99,11 @@ class DodgeballGame : public BasicAbstractGame {
         return BasicAbstractGame::will_reflect(src, target) || (src == ENEMY && (target == LAVA_WALL || target == out_of_bounds_object));
     }
 
+    bool is_blocked_by_entities(int type) override {
+        // only enemies bounce off lava walls, the agent and balls pass through every entity
+        return type == ENEMY;
+    }
+
     void handle_agent_collision(const std::shared_ptr<Entity> &obj) override {
         BasicAbstractGame::handle_agent_collision(obj);
 
@@ -27,6 +27,8 @@ class FruitBotGame : public BasicAbstractGame {
     float min_dim = 0.0f;
     float bullet_vscale = 0.0f;
     int last_fire_time = 0;
+    // the doors in entities order, which is also increasing y since walls are added bottom up
+    std::vector<std::shared_ptr<Entity>> doors;
 
     FruitBotGame()
         : BasicAbstractGame(NAME) {
@@ -38,6 +40,10 @@ class FruitBotGame : public BasicAbstractGame {
         bg_tile_ratio = -1;
 
         out_of_bounds_object = OUT_OF_BOUNDS_WALL;
+
+        // only the agent moves with sub_step and no entity blocks it, the handlers never move entities
+        entities_block_movement = false;
+        use_collision_broadphase = true;
     }
 
     void load_background_images() override {
@@ -124,11 +130,10 @@ class FruitBotGame : public BasicAbstractGame {
                 target->will_erase = true;
 
                 // find and erase the corresponding door entity
-                for (auto ent : entities) {
-                    if (ent->type == LOCKED_DOOR && fabs(ent->y - target->y) < 1) {
-                        ent->will_erase = true;
-                        break;
-                    }
+                auto it = std::partition_point(doors.begin(), doors.end(), [&](const std::shared_ptr<Entity> &door) { return door->y <= target->y - 1; });
+
+                if (it != doors.end() && fabs((*it)->y - target->y) < 1) {
+                    (*it)->will_erase = true;
                 }
             }
         }
@@ -189,7 +194,7 @@ class FruitBotGame : public BasicAbstractGame {
             float lock_x = w1 + lock_rx + is_on_right * (gapw - 2 * lock_rx);
             float door_x = w1 + gapw / 2 - (is_on_right * 2 - 1) * lock_rx;
 
-            add_entity_rxy(door_x, ry, 0, 0, gapw / 2 - lock_rx, wall_ry, LOCKED_DOOR);
+            doors.push_back(add_entity_rxy(door_x, ry, 0, 0, gapw / 2 - lock_rx, wall_ry, LOCKED_DOOR));
             add_entity_rxy(lock_x, ry - lock_ry + wall_ry, 0, 0, lock_rx, lock_ry, LOCK);
         }
     }
@@ -198,6 +203,7 @@ class FruitBotGame : public BasicAbstractGame {
         BasicAbstractGame::game_reset();
 
         last_fire_time = 0;
+        doors.clear();
 
         int min_sep = 4;
         int num_walls = 10;
@@ -252,6 +258,9 @@ class FruitBotGame : public BasicAbstractGame {
     void game_step() override {
         BasicAbstractGame::game_step();
 
+        // erase_if_needed has removed these from entities
+        doors.erase(std::remove_if(doors.begin(), doors.end(), [](const std::shared_ptr<Entity> &door) { return door->will_erase; }), doors.end());
+
         if (special_action == 1 && (cur_time - last_fire_time) >= KEY_DURATION) {
             float vx = 0;
             float vy = 1;
@@ -276,6 +285,16 @@ class FruitBotGame : public BasicAbstractGame {
         last_fire_time = b->read_int();
     }
 
+    void restore_derived_state() override {
+        doors.clear();
+
+        for (const auto &ent : entities) {
+            if (ent->type == LOCKED_DOOR) {
+                doors.push_back(ent);
+            }
+        }
+    }
+
     void set_environment(ReadBuffer *b) override {}
 };
 
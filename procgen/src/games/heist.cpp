@@ -2,6 +2,7 @@
 #include "../assetgen.h"
 #include <set>
 #include <queue>
+#include <map>
 #include "../mazegen.h"
 #include "../cpp-utils.h"
 
@@ -17,6 +18,8 @@ const int KEY_ON_RING = 11;
 class HeistGame : public BasicAbstractGame {
   public:
     std::shared_ptr<MazeGen> maze_gen;
+    // one generator per maze size, kept across resets so their buffers are reused
+    std::map<int, std::shared_ptr<MazeGen>> maze_gens;
     int world_dim = 0;
     int num_keys = 0;
     std::vector<bool> has_keys;
@@ -144,7 +147,13 @@ class HeistGame : public BasicAbstractGame {
 
         float r_ent = maze_scale / 2;
 
-        maze_gen = std::make_shared<MazeGen>(&rand_gen, maze_dim);
+        auto &cached_maze_gen = maze_gens[maze_dim];
+
+        if (cached_maze_gen == nullptr) {
+            cached_maze_gen = std::make_shared<MazeGen>(&rand_gen, maze_dim);
+        }
+
+        maze_gen = cached_maze_gen;
         maze_gen->generate_maze_with_doors(num_keys);
 
         // move agent out of the way for maze generation
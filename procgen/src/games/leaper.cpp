@@ -32,10 +32,16 @@ class LeaperGame : public BasicAbstractGame {
     std::vector<float> water_lane_speeds;
     int goal_y = 0;
 
+    // the logs of each water lane in spawn order, which is also their x order since every log in a
+    // lane moves at the lane's speed, so the oldest logs are the first to leave the screen
+    std::vector<std::vector<std::shared_ptr<Entity>>> lane_logs;
+
     LeaperGame()
         : BasicAbstractGame(NAME) {
         maxspeed = MAX_SPEED;
         timeout = 500;
+        // cars, logs and the finish line never block or push the agent
+        entities_block_movement = false;
     }
 
     void load_background_images() override {
@@ -173,6 +179,9 @@ class LeaperGame : public BasicAbstractGame {
 
         goal_y = bottom_water_y + num_water_lanes + 1;
 
+        lane_logs.clear();
+        lane_logs.resize(num_water_lanes);
+
         // spawn initial entities
         for (int i = 0; i < main_width / std::min(min_car_speed, min_log_speed); i++) {
             spawn_entities();
@@ -209,6 +218,7 @@ class LeaperGame : public BasicAbstractGame {
                 auto m = std::make_shared<Entity>(x, bottom_water_y + lane + 0.5, speed, 0, LOG_RADIUS, LOG);
                 if (!has_any_collision(m)) {
                     entities.push_back(m);
+                    lane_logs[lane].push_back(m);
                 }
             }
         }
@@ -247,6 +257,66 @@ class LeaperGame : public BasicAbstractGame {
         return BasicAbstractGame::get_adjusted_image_rect(type, rect);
     }
 
+    bool is_erased(const std::shared_ptr<Entity> &m) {
+        return m->will_erase || (m->auto_erase && is_out_of_bounds(m));
+    }
+
+    // drops the logs erase_if_needed removed from entities, which are always the oldest in a lane
+    void remove_erased_logs() {
+        for (auto &logs : lane_logs) {
+            size_t num_erased = 0;
+
+            while (num_erased < logs.size() && is_erased(logs[num_erased])) {
+                num_erased++;
+            }
+
+            logs.erase(logs.begin(), logs.begin() + num_erased);
+        }
+    }
+
+    bool find_log_under_agent(float *log_vx) {
+        bool standing_on_log = false;
+        float margin = -1 * agent->rx;
+        // a little more than the largest x distance has_collision accepts
+        float reach = agent->rx + LOG_RADIUS + margin + 0.01f;
+
+        for (int lane = 0; lane < int(lane_logs.size()); lane++) {
+            const auto &logs = lane_logs[lane];
+            int num_logs = int(logs.size());
+
+            if (num_logs == 0 || fabs(agent->y - logs[0]->y) >= (agent->ry + LOG_RADIUS) + margin) {
+                continue;
+            }
+
+            // logs moving left were spawned on the right, so spawn order is increasing x
+            bool increasing_x = water_lane_speeds[lane] < 0;
+            auto log_at = [&](int k) { return logs[increasing_x ? k : num_logs - 1 - k]; };
+
+            int low = 0;
+            int high = num_logs;
+
+            while (low < high) {
+                int mid = (low + high) / 2;
+
+                if (log_at(mid)->x <= agent->x - reach) {
+                    low = mid + 1;
+                } else {
+                    high = mid;
+                }
+            }
+
+            for (int k = low; k < num_logs && log_at(k)->x < agent->x + reach; k++) {
+                if (has_collision(agent, log_at(k), margin)) {
+                    // we're standing on a log, don't die
+                    standing_on_log = true;
+                    *log_vx = log_at(k)->vx;
+                }
+            }
+        }
+
+        return standing_on_log;
+    }
+
     void game_step() override {
         if (agent->image_theme >= 1) {
             agent->image_theme = (agent->image_theme + 1) % FROG_ANIMATION_FRAMES;
@@ -256,16 +326,10 @@ class LeaperGame : public BasicAbstractGame {
 
         spawn_entities();
 
-        bool standing_on_log = false;
+        remove_erased_logs();
+
         float log_vx = 0.0;
-        float margin = -1 * agent->rx;
-        for (auto &m : entities) {
-            if (m->type == LOG && has_collision(agent, m, margin)) {
-                // we're standing on a log, don't die
-                standing_on_log = true;
-                log_vx = m->vx;
-            }
-        }
+        bool standing_on_log = find_log_under_agent(&log_vx);
 
         if (get_obj(agent->x, agent->y) == WATER) {
             if (!standing_on_log && agent->vx == 0 && agent->vy == 0) {
@@ -300,6 +364,17 @@ class LeaperGame : public BasicAbstractGame {
         goal_y = b->read_int();
     }
 
+    void restore_derived_state() override {
+        lane_logs.clear();
+        lane_logs.resize(water_lane_speeds.size());
+
+        for (const auto &m : entities) {
+            if (m->type == LOG) {
+                lane_logs[int(m->y - bottom_water_y)].push_back(m);
+            }
+        }
+    }
+
     void set_environment(ReadBuffer *b) override {}
 };
 
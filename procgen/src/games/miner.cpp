@@ -2,6 +2,7 @@
 #include "../assetgen.h"
 #include <set>
 #include <queue>
+#include <functional>
 
 const std::string NAME = "miner";
 
@@ -18,10 +19,26 @@ const int DIRT = 9;
 
 const int OOB_WALL = 10;
 
+// flags of active_cells
+const uint8_t ACTIVE_THIS_STEP = 1;
+const uint8_t ACTIVE_NEXT_STEP = 2;
+
 class MinerGame : public BasicAbstractGame {
   public:
     int diamonds_remaining = 0;
 
+    // Gravity only needs to visit cells whose object may move. A cell is active if it or one of the
+    // cells its update depends on changed since it was last visited, every cell is active after a
+    // reset. Active cells are visited in increasing order like a full scan, cells that become active
+    // after the scan passed them are visited in the next step.
+    std::vector<uint8_t> active_cells;
+    std::priority_queue<int, std::vector<int>, std::greater<int>> active_this_step;
+    std::vector<int> active_next_step;
+    int scan_idx = -1;
+    int last_agent_cells[2] = {-1, -1};
+    // DIAMOND and MOVING_DIAMOND cells in the grid
+    int num_diamonds = 0;
+
     MinerGame()
         : BasicAbstractGame(NAME) {
         main_width = 20;
@@ -143,13 +160,13 @@ class MinerGame : public BasicAbstractGame {
         float diamond_pct = 12 / 400.0f;
         float boulder_pct = 80 / 400.0f;
 
-        int num_diamonds = (int)(diamond_pct * grid_size);
+        int num_diamonds_to_place = (int)(diamond_pct * grid_size);
         int num_boulders = (int)(boulder_pct * grid_size);
 
-        std::vector<int> obj_idxs = rand_gen.simple_choose(main_area, num_diamonds + num_boulders + 1);
+        rand_gen.simple_choose(main_area, num_diamonds_to_place + num_boulders + 1, chosen_idxs, choose_scratch);
 
-        int agent_x = obj_idxs[0] % main_width;
-        int agent_y = obj_idxs[0] / main_width;
+        int agent_x = chosen_idxs[0] % main_width;
+        int agent_y = chosen_idxs[0] / main_width;
 
         agent->x = agent_x + .5;
         agent->y = agent_y + .5;
@@ -158,13 +175,13 @@ class MinerGame : public BasicAbstractGame {
             set_obj(i, DIRT);
         }
 
-        for (int i = 0; i < num_diamonds; i++) {
-            int cell = obj_idxs[i + 1];
+        for (int i = 0; i < num_diamonds_to_place; i++) {
+            int cell = chosen_idxs[i + 1];
             set_obj(cell, DIAMOND);
         }
 
         for (int i = 0; i < num_boulders; i++) {
-            int cell = obj_idxs[i + 1 + num_diamonds];
+            int cell = chosen_idxs[i + 1 + num_diamonds_to_place];
             set_obj(cell, BOULDER);
         }
 
@@ -197,6 +214,60 @@ class MinerGame : public BasicAbstractGame {
         set_obj(exit_cell, SPACE);
         auto exit = add_entity((exit_cell % main_width) + .5, (exit_cell / main_width) + .5, 0, 0, .5, EXIT);
         exit->render_z = -1;
+
+        activate_all_cells();
+    }
+
+    void activate_all_cells() {
+        active_cells.assign(grid_size, ACTIVE_NEXT_STEP);
+        active_this_step = decltype(active_this_step)();
+        active_next_step.resize(grid_size);
+        for (int idx = 0; idx < grid_size; idx++) {
+            active_next_step[idx] = idx;
+        }
+        scan_idx = -1;
+        last_agent_cells[0] = last_agent_cells[1] = -1;
+
+        num_diamonds = 0;
+        for (int idx = 0; idx < grid_size; idx++) {
+            if (get_stationary_type(get_obj(idx)) == DIAMOND) {
+                num_diamonds++;
+            }
+        }
+    }
+
+    void activate(int idx) {
+        if (idx < 0 || idx >= grid_size) {
+            return;
+        }
+        if (idx > scan_idx) {
+            if (!(active_cells[idx] & ACTIVE_THIS_STEP)) {
+                active_cells[idx] |= ACTIVE_THIS_STEP;
+                active_this_step.push(idx);
+            }
+        } else if (!(active_cells[idx] & ACTIVE_NEXT_STEP)) {
+            active_cells[idx] |= ACTIVE_NEXT_STEP;
+            active_next_step.push_back(idx);
+        }
+    }
+
+    // activates the cells whose update reads idx, the cell itself, the cell above it and the cells
+    // next to these
+    void activate_dependents(int idx) {
+        if (idx < 0 || idx >= grid_size) {
+            return;
+        }
+        activate(idx);
+        activate(idx - 1);
+        activate(idx + 1);
+        activate(idx + main_width);
+        activate(idx + main_width - 1);
+        activate(idx + main_width + 1);
+    }
+
+    void set_cell(int idx, int type) {
+        set_obj(idx, type);
+        activate_dependents(idx);
     }
 
     int get_moving_type(int type) {
@@ -234,12 +305,12 @@ class MinerGame : public BasicAbstractGame {
         int agentx = agent_idx % main_width;
 
         if (action_vx == 1 && (agent->vx == 0) && (agentx < main_width - 2) && get_obj(agent_idx + 1) == BOULDER && get_obj(agent_idx + 2) == SPACE) {
-            set_obj(agent_idx + 1, SPACE);
-            set_obj(agent_idx + 2, BOULDER);
+            set_cell(agent_idx + 1, SPACE);
+            set_cell(agent_idx + 2, BOULDER);
             agent->x += 1;
         } else if (action_vx == -1 && (agent->vx == 0) && (agentx > 1) && get_obj(agent_idx - 1) == BOULDER && get_obj(agent_idx - 2) == SPACE) {
-            set_obj(agent_idx - 1, SPACE);
-            set_obj(agent_idx - 2, BOULDER);
+            set_cell(agent_idx - 1, SPACE);
+            set_cell(agent_idx - 2, BOULDER);
             agent->x -= 1;
         }
     }
@@ -247,6 +318,14 @@ class MinerGame : public BasicAbstractGame {
     void game_step() override {
         BasicAbstractGame::game_step();
 
+        // cells activated during the last scan are visited in this one
+        scan_idx = -1;
+        for (int idx : active_next_step) {
+            active_cells[idx] &= ~ACTIVE_NEXT_STEP;
+            activate(idx);
+        }
+        active_next_step.clear();
+
         if (action_vx > 0)
             agent->is_reflected = false;
         if (action_vx < 0)
@@ -258,45 +337,63 @@ class MinerGame : public BasicAbstractGame {
 
         if (agent_obj == DIAMOND) {
             step_data.reward += DIAMOND_REWARD;
+            num_diamonds--;
         }
 
         if (agent_obj == DIRT || agent_obj == DIAMOND) {
-            set_obj(int(agent->x), int(agent->y), SPACE);
+            set_cell(get_agent_index(), SPACE);
+        }
+
+        int agent_idx = (agent->y - .5) * main_width + (agent->x - .5);
+
+        // falling and rolling objects check the agent position
+        int agent_cells[2] = {agent_idx, get_agent_index()};
+        if (agent_cells[0] != last_agent_cells[0] || agent_cells[1] != last_agent_cells[1]) {
+            for (int i = 0; i < 2; i++) {
+                activate_dependents(last_agent_cells[i]);
+                activate_dependents(agent_cells[i]);
+                last_agent_cells[i] = agent_cells[i];
+            }
         }
 
-        int main_area = main_width * main_height;
+        // a full scan counts a diamond again each time it rolls right into a cell the scan has not reached yet
+        int diamonds_count = num_diamonds;
 
-        int diamonds_count = 0;
+        while (!active_this_step.empty()) {
+            int idx = active_this_step.top();
+            active_this_step.pop();
+            active_cells[idx] &= ~ACTIVE_THIS_STEP;
+            scan_idx = idx;
 
-        for (int idx = 0; idx < main_area; idx++) {
             int obj = get_obj(idx);
 
             int obj_x = idx % main_width;
-            int agent_idx = (agent->y - .5) * main_width + (agent->x - .5);
 
             int stat_type = get_stationary_type(obj);
 
-            if (stat_type == DIAMOND) {
-                diamonds_count++;
-            }
-
             if (obj == BOULDER || obj == MOVING_BOULDER || obj == DIAMOND || obj == MOVING_DIAMOND) {
                 int below_idx = idx - main_width;
                 int obj2 = get_obj(below_idx);
                 bool agent_is_below = agent_idx == below_idx;
 
                 if (obj2 == SPACE && !agent_is_below) {
-                    set_obj(idx, SPACE);
-                    set_obj(below_idx, get_moving_type(obj));
+                    set_cell(idx, SPACE);
+                    set_cell(below_idx, get_moving_type(obj));
                 } else if (agent_is_below && is_moving(obj)) {
                     step_data.done = true;
+                    // still moving in the next step
+                    activate(idx);
                 } else if (is_round(obj2) && obj_x > 0 && is_free(idx - 1) && is_free(idx - main_width - 1)) {
-                    set_obj(idx, SPACE);
-                    set_obj(idx - 1, get_stationary_type(obj));
+                    set_cell(idx, SPACE);
+                    set_cell(idx - 1, get_stationary_type(obj));
                 } else if (is_round(obj2) && obj_x < main_width - 1 && is_free(idx + 1) && is_free(idx - main_width + 1)) {
-                    set_obj(idx, SPACE);
-                    set_obj(idx + 1, stat_type);
+                    set_cell(idx, SPACE);
+                    set_cell(idx + 1, stat_type);
+                    if (stat_type == DIAMOND) {
+                        diamonds_count++;
+                    }
                 } else {
+                    // stopping doesn't change what the neighbors see
                     set_obj(idx, stat_type);
                 }
             }
@@ -323,6 +420,10 @@ class MinerGame : public BasicAbstractGame {
         diamonds_remaining = b->read_int();
     }
 
+    void restore_derived_state() override {
+        activate_all_cells();
+    }
+
     void set_environment(ReadBuffer *b) override {}
 };
 
@@ -136,7 +136,7 @@ class PlunderGame : public BasicAbstractGame {
             image_idxs.push_back(i);
         }
 
-        image_permutation = rand_gen.choose_n(image_idxs, num_total_ship_types);
+        rand_gen.choose_n(image_idxs, num_total_ship_types, image_permutation, choose_scratch);
 
         num_current_ship_types = 2;
 
@@ -51,6 +51,8 @@ class StarPilotGame : public BasicAbstractGame {
         : BasicAbstractGame(NAME) {
         main_width = 16;
         main_height = 16;
+        // player bullets are tested against every entity, the handlers only change health and flags
+        use_collision_broadphase = true;
     }
 
     void load_background_images() override {
@@ -385,7 +387,7 @@ class StarPilotGame : public BasicAbstractGame {
                 b_vx = b_vx * bv_scale;
                 b_vy = b_vy * bv_scale;
 
-                std::shared_ptr<Entity> new_bullet(new Entity(m->x, m->y, b_vx, b_vy, bullet_r, bullet_type));
+                auto new_bullet = std::make_shared<Entity>(m->x, m->y, b_vx, b_vy, bullet_r, bullet_type);
                 new_bullet->face_direction(b_vx, b_vy, -1 * PI / 2);
                 entities.push_back(new_bullet);
             }
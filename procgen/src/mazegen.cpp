@@ -229,11 +229,11 @@ void MazeGen::generate_maze_with_doors(int num_doors) {
         }
     }
 
-    std::vector<int> chosen = rand_gen->choose_n(forks, num_doors);
+    rand_gen->choose_n(forks, num_doors, chosen_doors, choose_scratch);
 
-    num_doors = (int)(chosen.size());
+    num_doors = (int)(chosen_doors.size());
 
-    for (int i : chosen) {
+    for (int i : chosen_doors) {
         grid.set_index(i, DOOR_OBJ);
     }
 
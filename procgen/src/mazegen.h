@@ -33,6 +33,9 @@ class MazeGen {
     std::vector<int> cell_sets_idxs;
     std::set<int> free_cell_set;
     std::vector<int> free_cells;
+    // reused by generate_maze_with_doors so choosing the doors doesn't allocate
+    std::vector<int> chosen_doors;
+    std::vector<int> choose_scratch;
 
     void get_neighbors(int idx, int type, std::vector<int> &neighbors);
     int lookup(int x, int y);
@@ -0,0 +1,109 @@
+#pragma once
+
+/*
+
+Optional timing of the phases of a game step, enabled with the phase_timing option
+
+When disabled the stats pointers are null and a PhaseTimer is a single branch, no clock is read.
+
+*/
+
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+
+enum GamePhase {
+    PhaseGameStep = 0,
+    PhaseReset = 1,
+    PhaseRender = 2,
+    PhaseConvert = 3,
+    NUM_PHASES = 4,
+};
+
+// info keys for the time spent in each phase during the most recent step
+const char *const PHASE_INFO_NAMES[NUM_PHASES] = {
+    "phase_game_step_ns",
+    "phase_reset_ns",
+    "phase_render_ns",
+    "phase_convert_ns",
+};
+
+// bucket i counts samples with a duration in [2^i, 2^(i+1)) nanoseconds
+const int PHASE_HIST_BUCKETS = 32;
+
+// total_ns, count and the histogram for each phase
+const int PHASE_STATS_VALUES = NUM_PHASES * (2 + PHASE_HIST_BUCKETS);
+
+inline int64_t phase_clock_ns() {
+    auto t = std::chrono::steady_clock::now().time_since_epoch();
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(t).count();
+}
+
+struct PhaseStats {
+    // reset after the timings are written to the info buffers
+    int64_t last_ns[NUM_PHASES];
+
+    int64_t total_ns[NUM_PHASES];
+    int64_t count[NUM_PHASES];
+    int64_t hist[NUM_PHASES][PHASE_HIST_BUCKETS];
+
+    PhaseStats() {
+        clear();
+    }
+
+    void clear() {
+        memset(last_ns, 0, sizeof(last_ns));
+        memset(total_ns, 0, sizeof(total_ns));
+        memset(count, 0, sizeof(count));
+        memset(hist, 0, sizeof(hist));
+    }
+
+    void record(int phase, int64_t ns) {
+        int bucket = 0;
+        for (int64_t v = ns; v > 1 && bucket < PHASE_HIST_BUCKETS - 1; v >>= 1) {
+            bucket++;
+        }
+
+        last_ns[phase] += ns;
+        total_ns[phase] += ns;
+        count[phase] += 1;
+        hist[phase][bucket] += 1;
+    }
+
+    // layout matches PHASE_STATS_VALUES
+    void write(int64_t *out) const {
+        for (int p = 0; p < NUM_PHASES; p++) {
+            int64_t *dst = out + p * (2 + PHASE_HIST_BUCKETS);
+            dst[0] = total_ns[p];
+            dst[1] = count[p];
+            memcpy(dst + 2, hist[p], sizeof(hist[p]));
+        }
+    }
+};
+
+// records the lifetime of the scope to the env stats and to the stats of the thread running it
+class PhaseTimer {
+  public:
+    PhaseTimer(PhaseStats *_env_stats, PhaseStats *_thread_stats, int _phase)
+        : env_stats(_env_stats), thread_stats(_thread_stats), phase(_phase) {
+        if (env_stats != nullptr) {
+            start_ns = phase_clock_ns();
+        }
+    }
+
+    ~PhaseTimer() {
+        if (env_stats != nullptr) {
+            int64_t elapsed = phase_clock_ns() - start_ns;
+            env_stats->record(phase, elapsed);
+            if (thread_stats != nullptr) {
+                thread_stats->record(phase, elapsed);
+            }
+        }
+    }
+
+  private:
+    PhaseStats *env_stats;
+    PhaseStats *thread_stats;
+    int phase;
+    int64_t start_ns = 0;
+};
@@ -0,0 +1,418 @@
+/*
+
+Native benchmark for the libenv interface
+
+Drives libenv_make, libenv_act and libenv_observe directly for each registered game, so the numbers
+don't include python, gym3 or cffi overhead. For every combination of game, num_envs, num_threads
+and swept options it reports step throughput, per-batch step latency percentiles and reset cost
+as JSON on stdout.
+
+usage:
+    procgen_bench [--games coinrun,miner] [--num_envs 1,16,64] [--num_threads 0,4]
+                  [--steps 1000] [--warmup_steps 100] [--reset_rounds 20] [--seed 0]
+                  [--resource_root path/to/assets/] [--option name=v1,v2] [--flag name=0,1]
+
+--option sweeps an int32 libenv option, --flag sweeps a bool libenv option. distribution_mode
+defaults to hard, which all games support, when sweeping it pass only --games that support the
+requested modes since unsupported combinations abort the process.
+
+Resets are timed by acting with -1 on every env, which still runs a step and renders the new
+observation. forced_reset_step_mean_us is the time of such a batch, reset_batch_mean_us subtracts
+step_mean_us from it to estimate the cost of the resets alone.
+
+*/
+
+#include "libenv.h"
+#include <chrono>
+#include <algorithm>
+#include <string>
+#include <vector>
+#include <cstring>
+#include <cstdio>
+#include <cstdlib>
+#include <cstdint>
+
+#ifndef PROCGEN_DEFAULT_RESOURCE_ROOT
+#define PROCGEN_DEFAULT_RESOURCE_ROOT ""
+#endif
+
+// matches the number of combos in env.py
+const int NUM_ACTIONS = 15;
+
+extern "C" int get_game_names(char *data, int length);
+
+struct SweptOption {
+    std::string name;
+    bool is_bool = false;
+    std::vector<int32_t> values;
+};
+
+struct BenchConfig {
+    std::vector<std::string> games;
+    std::vector<int> num_envs = {1, 16, 64};
+    std::vector<int> num_threads = {0, 4};
+    int steps = 1000;
+    int warmup_steps = 100;
+    int reset_rounds = 20;
+    int seed = 0;
+    std::string resource_root = PROCGEN_DEFAULT_RESOURCE_ROOT;
+    std::vector<SweptOption> swept_options;
+};
+
+struct BenchResult {
+    double make_s = 0;
+    double initial_reset_s = 0;
+    double steps_per_s = 0;
+    double step_p50_us = 0;
+    double step_p99_us = 0;
+    double step_mean_us = 0;
+    double forced_reset_step_mean_us = 0;
+    double reset_batch_mean_us = 0;
+};
+
+static std::vector<std::string> split_list(const std::string &s) {
+    std::vector<std::string> parts;
+    size_t start = 0;
+
+    while (start <= s.size()) {
+        size_t end = s.find(',', start);
+        if (end == std::string::npos) {
+            end = s.size();
+        }
+        if (end > start) {
+            parts.push_back(s.substr(start, end - start));
+        }
+        start = end + 1;
+    }
+
+    return parts;
+}
+
+static std::vector<int> parse_int_list(const std::string &s) {
+    std::vector<int> values;
+    for (const auto &part : split_list(s)) {
+        values.push_back(atoi(part.c_str()));
+    }
+    return values;
+}
+
+static SweptOption parse_swept_option(const std::string &s, bool is_bool) {
+    SweptOption opt;
+    size_t eq = s.find('=');
+
+    if (eq == std::string::npos) {
+        fprintf(stderr, "expected name=value for option %s\n", s.c_str());
+        exit(EXIT_FAILURE);
+    }
+
+    opt.name = s.substr(0, eq);
+    opt.is_bool = is_bool;
+    opt.values = parse_int_list(s.substr(eq + 1));
+    return opt;
+}
+
+static std::vector<std::string> registered_games() {
+    int length = get_game_names(nullptr, 0);
+    std::string names(length, '\x00');
+    get_game_names(&names[0], length);
+    return split_list(names);
+}
+
+static double now_s() {
+    auto t = std::chrono::steady_clock::now().time_since_epoch();
+    return std::chrono::duration<double>(t).count();
+}
+
+static size_t tensor_size(const libenv_tensortype &t) {
+    size_t elem_size = 1;
+
+    if (t.dtype == LIBENV_DTYPE_INT32 || t.dtype == LIBENV_DTYPE_FLOAT32) {
+        elem_size = 4;
+    }
+
+    size_t count = 1;
+
+    for (int i = 0; i < t.ndim; i++) {
+        count *= t.shape[i];
+    }
+
+    return count * elem_size;
+}
+
+static double percentile(std::vector<double> samples, double pct) {
+    if (samples.empty()) {
+        return 0;
+    }
+
+    std::sort(samples.begin(), samples.end());
+    size_t idx = (size_t)(pct * (samples.size() - 1));
+    return samples[idx];
+}
+
+// owns the buffers handed to libenv_set_buffers
+class BenchEnv {
+  public:
+    libenv_env *env = nullptr;
+    int num_envs = 0;
+    std::vector<int32_t> actions;
+
+    BenchEnv(libenv_env *_env, int _num_envs) : env(_env), num_envs(_num_envs) {
+        actions.resize(num_envs, 0);
+        rew.resize(num_envs);
+        first.resize(num_envs);
+
+        allocate(LIBENV_SPACE_OBSERVATION, ob_storage, ob_ptrs);
+        allocate(LIBENV_SPACE_INFO, info_storage, info_ptrs);
+
+        for (int e = 0; e < num_envs; e++) {
+            ac_ptrs.push_back(&actions[e]);
+        }
+
+        struct libenv_buffers bufs;
+        bufs.ob = ob_ptrs.data();
+        bufs.rew = rew.data();
+        bufs.first = first.data();
+        bufs.info = info_ptrs.data();
+        bufs.ac = ac_ptrs.data();
+        libenv_set_buffers(env, &bufs);
+    }
+
+    ~BenchEnv() {
+        libenv_close(env);
+    }
+
+  private:
+    std::vector<std::vector<uint8_t>> ob_storage;
+    std::vector<std::vector<uint8_t>> info_storage;
+    std::vector<void *> ob_ptrs;
+    std::vector<void *> info_ptrs;
+    std::vector<void *> ac_ptrs;
+    std::vector<float> rew;
+    std::vector<uint8_t> first;
+
+    // buffers are laid out as [space][env], matching convert_bufs in vecgame.cpp
+    void allocate(enum libenv_space_name name, std::vector<std::vector<uint8_t>> &storage, std::vector<void *> &ptrs) {
+        int count = libenv_get_tensortypes(env, name, nullptr);
+        std::vector<struct libenv_tensortype> types(count);
+        libenv_get_tensortypes(env, name, types.data());
+
+        for (int s = 0; s < count; s++) {
+            for (int e = 0; e < num_envs; e++) {
+                storage.emplace_back(tensor_size(types[s]));
+                ptrs.push_back(storage.back().data());
+            }
+        }
+    }
+};
+
+static libenv_option make_option(const std::string &name, enum libenv_dtype dtype, void *data, int count) {
+    libenv_option opt;
+    memset(&opt, 0, sizeof(opt));
+    strncpy(opt.name, name.c_str(), LIBENV_MAX_NAME_LEN - 1);
+    opt.dtype = dtype;
+    opt.count = count;
+    opt.data = data;
+    return opt;
+}
+
+static BenchResult run_config(const BenchConfig &cfg, const std::string &game, int num_envs, int num_threads, const std::vector<SweptOption> &swept, const std::vector<int32_t> &swept_values) {
+    int32_t num_levels = 0;
+    int32_t start_level = 0;
+    int32_t num_actions = NUM_ACTIONS;
+    int32_t rand_seed = cfg.seed;
+    int32_t threads = num_threads;
+    int32_t distribution_mode = 1;
+
+    std::vector<uint8_t> bool_values(swept.size());
+    std::vector<int32_t> int_values(swept_values);
+    std::vector<libenv_option> items;
+    bool has_distribution_mode = false;
+
+    items.push_back(make_option("env_name", LIBENV_DTYPE_UINT8, (void *)game.c_str(), (int)game.size()));
+    items.push_back(make_option("num_levels", LIBENV_DTYPE_INT32, &num_levels, 1));
+    items.push_back(make_option("start_level", LIBENV_DTYPE_INT32, &start_level, 1));
+    items.push_back(make_option("num_actions", LIBENV_DTYPE_INT32, &num_actions, 1));
+    items.push_back(make_option("rand_seed", LIBENV_DTYPE_INT32, &rand_seed, 1));
+    items.push_back(make_option("num_threads", LIBENV_DTYPE_INT32, &threads, 1));
+    items.push_back(make_option("resource_root", LIBENV_DTYPE_UINT8, (void *)cfg.resource_root.c_str(), (int)cfg.resource_root.size()));
+
+    for (size_t i = 0; i < swept.size(); i++) {
+        if (swept[i].name == "distribution_mode") {
+            has_distribution_mode = true;
+        }
+
+        if (swept[i].is_bool) {
+            bool_values[i] = (uint8_t)(swept_values[i] != 0);
+            items.push_back(make_option(swept[i].name, LIBENV_DTYPE_UINT8, &bool_values[i], 1));
+        } else {
+            items.push_back(make_option(swept[i].name, LIBENV_DTYPE_INT32, &int_values[i], 1));
+        }
+    }
+
+    if (!has_distribution_mode) {
+        items.push_back(make_option("distribution_mode", LIBENV_DTYPE_INT32, &distribution_mode, 1));
+    }
+
+    struct libenv_options options;
+    options.items = items.data();
+    options.count = (int)(items.size());
+
+    BenchResult result;
+
+    double t0 = now_s();
+    libenv_env *handle = libenv_make(num_envs, options);
+    result.make_s = now_s() - t0;
+
+    t0 = now_s();
+    BenchEnv benv(handle, num_envs);
+    // the initial reset of every env happens here
+    libenv_observe(handle);
+    result.initial_reset_s = now_s() - t0;
+
+    uint32_t action_state = (uint32_t)(cfg.seed) * 2654435761u + 1;
+    std::vector<double> latencies;
+    latencies.reserve(cfg.steps);
+    double total_s = 0;
+
+    for (int step = 0; step < cfg.warmup_steps + cfg.steps; step++) {
+        for (int e = 0; e < num_envs; e++) {
+            action_state = action_state * 1664525u + 1013904223u;
+            benv.actions[e] = (int32_t)((action_state >> 16) % NUM_ACTIONS);
+        }
+
+        double start = now_s();
+        libenv_act(handle);
+        libenv_observe(handle);
+        double elapsed = now_s() - start;
+
+        if (step >= cfg.warmup_steps) {
+            latencies.push_back(elapsed * 1e6);
+            total_s += elapsed;
+        }
+    }
+
+    if (total_s > 0) {
+        result.steps_per_s = (double)(num_envs) * cfg.steps / total_s;
+        result.step_mean_us = total_s * 1e6 / cfg.steps;
+    }
+    result.step_p50_us = percentile(latencies, 0.50);
+    result.step_p99_us = percentile(latencies, 0.99);
+
+    // an action of -1 forces every env to reset after its next step
+    double reset_total_s = 0;
+
+    for (int round = 0; round < cfg.reset_rounds; round++) {
+        for (int e = 0; e < num_envs; e++) {
+            benv.actions[e] = -1;
+        }
+
+        double start = now_s();
+        libenv_act(handle);
+        libenv_observe(handle);
+        reset_total_s += now_s() - start;
+    }
+
+    if (cfg.reset_rounds > 0) {
+        result.forced_reset_step_mean_us = reset_total_s * 1e6 / cfg.reset_rounds;
+        result.reset_batch_mean_us = std::max(result.forced_reset_step_mean_us - result.step_mean_us, 0.0);
+    }
+
+    return result;
+}
+
+static void usage_and_exit(const char *prog) {
+    fprintf(stderr, "usage: %s [--games a,b] [--num_envs 1,16] [--num_threads 0,4] [--steps n] [--warmup_steps n] [--reset_rounds n] [--seed n] [--resource_root path] [--option name=v1,v2] [--flag name=0,1]\n", prog);
+    exit(EXIT_FAILURE);
+}
+
+static BenchConfig parse_args(int argc, char **argv) {
+    BenchConfig cfg;
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+
+        if (i + 1 >= argc) {
+            usage_and_exit(argv[0]);
+        }
+
+        std::string value = argv[++i];
+
+        if (arg == "--games") {
+            cfg.games = split_list(value);
+        } else if (arg == "--num_envs") {
+            cfg.num_envs = parse_int_list(value);
+        } else if (arg == "--num_threads") {
+            cfg.num_threads = parse_int_list(value);
+        } else if (arg == "--steps") {
+            cfg.steps = atoi(value.c_str());
+        } else if (arg == "--warmup_steps") {
+            cfg.warmup_steps = atoi(value.c_str());
+        } else if (arg == "--reset_rounds") {
+            cfg.reset_rounds = atoi(value.c_str());
+        } else if (arg == "--seed") {
+            cfg.seed = atoi(value.c_str());
+        } else if (arg == "--resource_root") {
+            cfg.resource_root = value;
+        } else if (arg == "--option") {
+            cfg.swept_options.push_back(parse_swept_option(value, false));
+        } else if (arg == "--flag") {
+            cfg.swept_options.push_back(parse_swept_option(value, true));
+        } else {
+            usage_and_exit(argv[0]);
+        }
+    }
+
+    if (cfg.games.empty()) {
+        cfg.games = registered_games();
+    }
+
+    return cfg;
+}
+
+int main(int argc, char **argv) {
+    BenchConfig cfg = parse_args(argc, argv);
+
+    // every combination of the swept option values
+    std::vector<std::vector<int32_t>> combos = {{}};
+
+    for (const auto &opt : cfg.swept_options) {
+        std::vector<std::vector<int32_t>> next;
+        for (const auto &combo : combos) {
+            for (int32_t v : opt.values) {
+                next.push_back(combo);
+                next.back().push_back(v);
+            }
+        }
+        combos = next;
+    }
+
+    bool first_result = true;
+    printf("[\n");
+
+    for (const auto &game : cfg.games) {
+        for (const auto &combo : combos) {
+            for (int num_envs : cfg.num_envs) {
+                for (int num_threads : cfg.num_threads) {
+                    BenchResult r = run_config(cfg, game, num_envs, num_threads, cfg.swept_options, combo);
+
+                    if (!first_result) {
+                        printf(",\n");
+                    }
+                    first_result = false;
+
+                    printf("  {\"game\": \"%s\", \"num_envs\": %d, \"num_threads\": %d, \"steps\": %d, \"options\": {", game.c_str(), num_envs, num_threads, cfg.steps);
+                    for (size_t i = 0; i < cfg.swept_options.size(); i++) {
+                        printf("%s\"%s\": %d", i > 0 ? ", " : "", cfg.swept_options[i].name.c_str(), combo[i]);
+                    }
+                    printf("}, \"make_s\": %.6f, \"initial_reset_s\": %.6f, \"steps_per_s\": %.1f, \"step_mean_us\": %.2f, \"step_p50_us\": %.2f, \"step_p99_us\": %.2f, \"forced_reset_step_mean_us\": %.2f, \"reset_batch_mean_us\": %.2f}",
+                           r.make_s, r.initial_reset_s, r.steps_per_s, r.step_mean_us, r.step_p50_us, r.step_p99_us, r.forced_reset_step_mean_us, r.reset_batch_mean_us);
+                    fflush(stdout);
+                }
+            }
+        }
+    }
+
+    printf("\n]\n");
+
+    return 0;
+}
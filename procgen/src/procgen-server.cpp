@@ -0,0 +1,136 @@
+/*
+
+Hosts a VecGame in its own process for the shm client library
+
+The client library starts this process and passes the name of the control segment it created, see
+shm-env.h for the protocol. The process exits when the client closes the environment or when the
+client process dies.
+
+usage:
+    procgen_server /control-segment-name
+
+*/
+
+#include "libenv.h"
+#include "shm-env.h"
+#include "cpp-utils.h"
+#include <cstring>
+#include <string>
+#include <vector>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static void *map_segment(const std::string &name, size_t size, bool create) {
+    int fd = shm_open(name.c_str(), create ? O_RDWR | O_CREAT | O_EXCL : O_RDWR, 0600);
+    if (fd < 0) {
+        fatal("failed to open shared memory segment %s\n", name.c_str());
+    }
+    if (create && ftruncate(fd, size) != 0) {
+        fatal("failed to size shared memory segment %s\n", name.c_str());
+    }
+    void *ptr = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (ptr == MAP_FAILED) {
+        fatal("failed to map shared memory segment %s\n", name.c_str());
+    }
+    return ptr;
+}
+
+int main(int argc, char **argv) {
+    if (argc != 2) {
+        fprintf(stderr, "usage: %s /control-segment-name\n", argv[0]);
+        return 1;
+    }
+
+    std::string control_name = argv[1];
+    pid_t client_pid = getppid();
+
+    auto header = (ShmEnvHeader *)(map_segment(control_name, sizeof(ShmEnvHeader), false));
+    fassert(header->magic == SHM_ENV_MAGIC);
+
+    int num_envs = header->num_envs;
+    auto options = shm_env_read_options(header);
+    libenv_env *env = libenv_make(num_envs, libenv_options{options.data(), (int)(options.size())});
+
+    for (int s = 0; s < SHM_ENV_NUM_SPACES; s++) {
+        auto name = (enum libenv_space_name)(s + 1);
+        int count = libenv_get_tensortypes(env, name, nullptr);
+        if (count > SHM_ENV_MAX_TYPES) {
+            header->error = 1;
+            fatal("too many tensortypes for the shared memory header\n");
+        }
+        libenv_get_tensortypes(env, name, header->types[s]);
+        header->num_types[s] = count;
+    }
+
+    ShmEnvLayout layout = shm_env_layout(header);
+    header->data_size = layout.size;
+    auto data = (uint8_t *)(map_segment(shm_env_data_name(control_name), layout.size, true));
+
+    // the VecGame writes observations straight into the data segment
+    auto env_ptrs = [&](const std::vector<size_t> &offsets, int space) {
+        std::vector<void *> ptrs;
+        for (size_t i = 0; i < offsets.size(); i++) {
+            size_t size = shm_env_tensortype_size(header->types[space - 1][i]);
+            for (int e = 0; e < num_envs; e++) {
+                ptrs.push_back(data + offsets[i] + e * size);
+            }
+        }
+        return ptrs;
+    };
+
+    std::vector<void *> ob = env_ptrs(layout.ob_offsets, LIBENV_SPACE_OBSERVATION);
+    std::vector<void *> info = env_ptrs(layout.info_offsets, LIBENV_SPACE_INFO);
+    std::vector<void *> ac = env_ptrs(layout.ac_offsets, LIBENV_SPACE_ACTION);
+
+    struct libenv_buffers bufs;
+    bufs.ob = ob.data();
+    bufs.rew = (float *)(data + layout.rew_offset);
+    bufs.first = data + layout.first_offset;
+    bufs.info = info.data();
+    bufs.ac = ac.data();
+    libenv_set_buffers(env, &bufs);
+
+    // the client sends no commands before the server is ready, so the first one is request 1
+    uint32_t last_request = 0;
+
+    // signals the client that the data segment is ready
+    header->response_seq++;
+    shm_futex_wake(&header->response_seq);
+
+    while (1) {
+        while (!shm_futex_wait(&header->request_seq, last_request, 1000)) {
+            if (getppid() != client_pid) {
+                // the client died without closing the environment
+                libenv_close(env);
+                return 1;
+            }
+        }
+        last_request = header->request_seq.load();
+
+        int command = header->command;
+        if (command == ShmEnvCommandAct) {
+            libenv_act(env);
+        } else if (command == ShmEnvCommandObserve) {
+            libenv_observe(env);
+        } else if (command == ShmEnvCommandClose) {
+            libenv_close(env);
+        } else {
+            fatal("unknown command %d\n", command);
+        }
+
+        header->response_seq++;
+        shm_futex_wake(&header->response_seq);
+
+        if (command == ShmEnvCommandClose) {
+            break;
+        }
+    }
+
+    munmap(data, layout.size);
+    munmap(header, sizeof(ShmEnvHeader));
+
+    return 0;
+}
@@ -1,25 +1,58 @@
 #include "randgen.h"
 #include "cpp-utils.h"
-#include <set>
+#include <algorithm>
 #include <sstream>
 
+static inline uint32_t rotl32(uint32_t x, int k) {
+    return (x << k) | (x >> (32 - k));
+}
+
+// splitmix64, used to expand a 32 bit seed into the xoshiro state
+static inline uint64_t splitmix64(uint64_t &x) {
+    uint64_t z = (x += 0x9e3779b97f4a7c15ULL);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
+}
+
+uint32_t RandGen::next_uint32() {
+    if (gen_type == RandGenMT19937) {
+        return stdgen();
+    }
+
+    // xoshiro128++ (https://prng.di.unimi.it/xoshiro128plusplus.c)
+    uint32_t *s = xoshiro_state;
+    uint32_t result = rotl32(s[0] + s[3], 7) + s[0];
+    uint32_t t = s[1] << 9;
+
+    s[2] ^= s[0];
+    s[3] ^= s[1];
+    s[1] ^= s[2];
+    s[0] ^= s[3];
+    s[2] ^= t;
+    s[3] = rotl32(s[3], 11);
+
+    return result;
+}
+
 int RandGen::randint(int low, int high) {
     fassert(is_seeded);
-    uint32_t x = stdgen();
+    uint32_t x = next_uint32();
     uint32_t range = high - low;
     return low + (x % range);
 }
 
 int RandGen::randn(int high) {
     fassert(is_seeded);
-    uint32_t x = stdgen();
+    uint32_t x = next_uint32();
     return (x % high);
 }
 
 float RandGen::rand01() {
     fassert(is_seeded);
-    uint32_t x = stdgen();
-    return (float)((double)(x) / ((double)(stdgen.max()) + 1));
+    uint32_t x = next_uint32();
+    // both generators produce the full range of 32 bit values
+    return (float)((double)(x) / ((double)(UINT32_MAX) + 1));
 }
 
 bool RandGen::randbool() {
@@ -48,67 +81,157 @@ int RandGen::choose_one(std::vector<int> &elems) {
 
 std::vector<int> RandGen::choose_n(const std::vector<int> &elems, int n) {
     std::vector<int> chosen;
-    std::vector<int> rem_elems;
+    std::vector<int> scratch;
+    choose_n(elems, n, chosen, scratch);
+    return chosen;
+}
 
-    for (int elem : elems) {
-        rem_elems.push_back(elem);
-    }
+void RandGen::choose_n(const std::vector<int> &elems, int n, std::vector<int> &chosen, std::vector<int> &scratch) {
+    int num_elems = (int)(elems.size());
 
-    if (n > (int)(elems.size())) {
-        return rem_elems;
+    if (n > num_elems) {
+        chosen.assign(elems.begin(), elems.end());
+        return;
     }
 
-    while (int(chosen.size()) < n) {
-        int next_elem_idx = randn((int)(rem_elems.size()));
-        chosen.push_back(rem_elems[next_elem_idx]);
-        rem_elems.erase(rem_elems.begin() + next_elem_idx);
-    }
+    chosen.resize(n);
 
-    return chosen;
+    if (gen_type == RandGenMT19937) {
+        // legacy sampling, each draw picks from the remaining elements in their original order,
+        // scratch holds the sorted positions of the elements chosen so far
+        scratch.resize(n);
+
+        for (int i = 0; i < n; i++) {
+            int pos = randn(num_elems - i);
+            int j = 0;
+
+            while (j < i && scratch[j] <= pos) {
+                pos++;
+                j++;
+            }
+
+            for (int m = i; m > j; m--) {
+                scratch[m] = scratch[m - 1];
+            }
+
+            scratch[j] = pos;
+            chosen[i] = elems[pos];
+        }
+    } else {
+        // partial fisher-yates shuffle
+        scratch.assign(elems.begin(), elems.end());
+
+        for (int i = 0; i < n; i++) {
+            int j = i + randn(num_elems - i);
+            std::swap(scratch[i], scratch[j]);
+            chosen[i] = scratch[i];
+        }
+    }
 }
 
 std::vector<int> RandGen::simple_choose(int n, int k) {
-    std::vector<int> chosen(k, 0);
-    std::set<int> set;
+    std::vector<int> chosen;
+    std::vector<int> scratch;
+    simple_choose(n, k, chosen, scratch);
+    return chosen;
+}
 
+void RandGen::simple_choose(int n, int k, std::vector<int> &chosen, std::vector<int> &scratch) {
     fassert(k <= n);
 
-    for (int i = 0; i < k; i++) {
-        int next = randn(n);
+    chosen.resize(k);
+
+    if (gen_type == RandGenMT19937) {
+        // legacy sampling, rejection sampling with scratch holding the sorted values chosen so far
+        scratch.clear();
+
+        for (int i = 0; i < k; i++) {
+            int next = randn(n);
+            auto it = std::lower_bound(scratch.begin(), scratch.end(), next);
 
-        while (set.find(next) != set.end()) {
-            next = randn(n);
+            while (it != scratch.end() && *it == next) {
+                next = randn(n);
+                it = std::lower_bound(scratch.begin(), scratch.end(), next);
+            }
+
+            chosen[i] = next;
+            scratch.insert(it, next);
         }
+    } else {
+        // partial fisher-yates shuffle of 0..n-1
+        scratch.resize(n);
 
-        chosen[i] = next;
-        set.insert(next);
-    }
+        for (int i = 0; i < n; i++) {
+            scratch[i] = i;
+        }
 
-    return chosen;
+        for (int i = 0; i < k; i++) {
+            int j = i + randn(n - i);
+            std::swap(scratch[i], scratch[j]);
+            chosen[i] = scratch[i];
+        }
+    }
 }
 
 int RandGen::randint() {
     fassert(is_seeded);
-    return stdgen();
+    return next_uint32();
+}
+
+void RandGen::set_type(RandGenType type) {
+    fassert(type == RandGenMT19937 || type == RandGenXoshiro128);
+    gen_type = type;
+    is_seeded = false;
+}
+
+RandGenType RandGen::get_type() {
+    return gen_type;
 }
 
 void RandGen::seed(int seed) {
-    stdgen.seed(seed);
+    if (gen_type == RandGenMT19937) {
+        stdgen.seed(seed);
+    } else {
+        uint64_t x = (uint32_t)(seed);
+        uint64_t a = splitmix64(x);
+        uint64_t b = splitmix64(x);
+        xoshiro_state[0] = (uint32_t)(a);
+        xoshiro_state[1] = (uint32_t)(a >> 32);
+        xoshiro_state[2] = (uint32_t)(b);
+        xoshiro_state[3] = (uint32_t)(b >> 32);
+    }
     is_seeded = true;
 }
 
 void RandGen::serialize(WriteBuffer *b) {
     b->write_int(is_seeded);
-    std::ostringstream ostream;
-    ostream << stdgen;
-    auto str = ostream.str();
-    b->write_string(str);
+    b->write_int(gen_type);
+
+    if (gen_type == RandGenMT19937) {
+        std::ostringstream ostream;
+        ostream << stdgen;
+        auto str = ostream.str();
+        b->write_string(str);
+    } else {
+        for (int i = 0; i < 4; i++) {
+            b->write_int((int)(xoshiro_state[i]));
+        }
+    }
 }
 
 void RandGen::deserialize(ReadBuffer *b) {
     is_seeded = b->read_int();
-    auto str = b->read_string();
-    std::istringstream istream;
-    istream.str(str);
-    istream >> stdgen;
+    gen_type = RandGenType(b->read_int());
+
+    if (gen_type == RandGenMT19937) {
+        auto str = b->read_string();
+        std::istringstream istream;
+        istream.str(str);
+        istream >> stdgen;
+    } else {
+        fassert(gen_type == RandGenXoshiro128);
+        for (int i = 0; i < 4; i++) {
+            xoshiro_state[i] = (uint32_t)(b->read_int());
+        }
+    }
 }
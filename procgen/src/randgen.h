@@ -4,11 +4,20 @@
 
 Random number generator with consistent behavior across platforms
 
+The underlying generator is std::mt19937 by default. xoshiro128++ can be selected instead, it has a
+16 byte state that is much cheaper to seed, copy and serialize, but produces a different sequence
+of numbers, so the same level seed generates a different level.
+
 */
 
 #include "buffer.h"
 #include <random>
 
+enum RandGenType {
+    RandGenMT19937 = 0,
+    RandGenXoshiro128 = 1,
+};
+
 class RandGen {
   public:
     std::mt19937 stdgen;
@@ -22,9 +31,20 @@ class RandGen {
     int choose_one(std::vector<int> &elems);
     std::vector<int> choose_n(const std::vector<int> &elems, int n);
     std::vector<int> simple_choose(int n, int k);
+    // these versions don't allocate once the chosen and scratch buffers have grown large enough,
+    // with mt19937 they reproduce the legacy draws exactly, with other generators they use a partial
+    // fisher-yates shuffle since levels differ from the legacy ones anyway
+    void choose_n(const std::vector<int> &elems, int n, std::vector<int> &chosen, std::vector<int> &scratch);
+    void simple_choose(int n, int k, std::vector<int> &chosen, std::vector<int> &scratch);
+    void set_type(RandGenType type);
+    RandGenType get_type();
     void seed(int seed);
     void serialize(WriteBuffer *b);
     void deserialize(ReadBuffer *b);
   private:
     bool is_seeded = false;
+    RandGenType gen_type = RandGenMT19937;
+    uint32_t xoshiro_state[4] = {0, 0, 0, 0};
+
+    uint32_t next_uint32();
 };
@@ -1,177 +1,273 @@
 #include "roomgen.h"
+#include <cstring>
 
-int RoomGenerator::count_neighbors(int idx, int type) {
-    int x, y;
-    game->to_grid_xy(idx, &x, &y);
-    int neighbors = 0;
+// the automaton counts neighbors for 8 cells at a time, with one byte per cell packed into a uint64_t
+const int LANES = (int)(sizeof(uint64_t));
+const uint64_t LANE_ONES = 0x0101010101010101ULL;
 
-    for (int i = -1; i <= 1; i++) {
-        for (int j = -1; j <= 1; j++) {
-            int curr_obj = game->get_obj(x + i, y + j);
+// a 3x3 neighborhood holds at most 9 walls, adding 123 to a lane sets its high bit exactly when
+// the count is at least 5, and never carries into the next lane
+const uint64_t LANE_WALL_THRESHOLD = 0x7B7B7B7B7B7B7B7BULL;
 
-            if (curr_obj == type) {
-                neighbors++;
-            }
-        }
-    }
+static inline uint64_t load_lanes(const uint8_t *src) {
+    uint64_t v;
+    memcpy(&v, src, sizeof(v));
+    return v;
+}
+
+static inline void store_lanes(uint8_t *dst, uint64_t v) {
+    memcpy(dst, &v, sizeof(v));
+}
+
+void RoomGenerator::prepare_buffers() {
+    // the flood fills treat out of bounds cells as blocked
+    fassert(game->out_of_bounds_object != SPACE);
+
+    w = game->grid.w;
+    h = game->grid.h;
+
+    // the lane loops may read and write up to LANES bytes past the end of a row
+    wall_mask.resize((w + 2) * (h + 2) + LANES);
+    col_counts.resize(w + 2 + 2 * LANES);
+    next_walls.resize(w * h + LANES);
 
-    return neighbors;
+    cell_marks.resize(w * h);
+    parents.resize(w * h);
+    search_queue.resize(w * h);
+}
+
+bool RoomGenerator::is_space(int x, int y) {
+    return game->grid.contains(x, y) && game->grid.data[y * w + x] == SPACE;
 }
 
 void RoomGenerator::update() {
     // update cellular automata
-    std::vector<int> next_cells;
+    // a cell becomes a wall when at least 5 cells of its 3x3 neighborhood are walls
+    prepare_buffers();
 
-    for (int i = 0; i < game->grid_size; i++) {
-        if (count_neighbors(i, WALL_OBJ) >= 5) {
-            next_cells.push_back(WALL_OBJ);
-        } else {
-            next_cells.push_back(SPACE);
+    const int *cells = game->grid.data.data();
+    int pw = w + 2;
+
+    uint8_t oob_is_wall = game->out_of_bounds_object == WALL_OBJ ? 1 : 0;
+    std::fill(wall_mask.begin(), wall_mask.end(), oob_is_wall);
+
+    for (int y = 0; y < h; y++) {
+        uint8_t *dst = &wall_mask[(y + 1) * pw + 1];
+        const int *src = cells + y * w;
+
+        for (int x = 0; x < w; x++) {
+            dst[x] = src[x] == WALL_OBJ ? 1 : 0;
         }
     }
 
-    for (int i = 0; i < game->grid_size; i++) {
-        game->set_obj(i, next_cells[i]);
-    }
-}
+    for (int y = 0; y < h; y++) {
+        const uint8_t *r0 = &wall_mask[y * pw];
+        const uint8_t *r1 = r0 + pw;
+        const uint8_t *r2 = r1 + pw;
+        uint8_t *cc = col_counts.data();
 
-void RoomGenerator::build_room(int idx, std::set<int> &room) {
-    std::queue<int> curr;
+        for (int x = 0; x < pw; x += LANES) {
+            store_lanes(cc + x, load_lanes(r0 + x) + load_lanes(r1 + x) + load_lanes(r2 + x));
+        }
 
-    if (game->get_obj(idx) != SPACE)
-        return;
+        // lanes past the end of this row spill into the next row, which is overwritten on the next iteration
+        uint8_t *out = &next_walls[y * w];
 
-    curr.push(idx);
+        for (int x = 0; x < w; x += LANES) {
+            uint64_t neighbors = load_lanes(cc + x) + load_lanes(cc + x + 1) + load_lanes(cc + x + 2);
+            store_lanes(out + x, ((neighbors + LANE_WALL_THRESHOLD) >> 7) & LANE_ONES);
+        }
+    }
 
-    while (curr.size() > 0) {
-        int curr_idx = curr.front();
-        curr.pop();
+    for (int i = 0; i < game->grid_size; i++) {
+        game->set_obj(i, next_walls[i] ? WALL_OBJ : SPACE);
+    }
+}
 
-        if (game->get_obj(curr_idx) != SPACE)
-            continue;
+int RoomGenerator::build_room(int idx, int room_id) {
+    int *queue = search_queue.data();
+    int head = 0;
+    int tail = 0;
 
-        int x, y;
-        game->to_grid_xy(curr_idx, &x, &y);
+    cell_marks[idx] = room_id;
+    queue[tail++] = idx;
 
-        for (int i = -1; i <= 1; i++) {
-            for (int j = -1; j <= 1; j++) {
-                if ((i == 0 || j == 0) && (i + j != 0)) {
-                    int next_idx = game->to_grid_idx(x + i, y + j);
+    while (head < tail) {
+        int curr_idx = queue[head++];
+        int x = curr_idx % w;
+        int y = curr_idx / w;
 
-                    if (!set_contains(room, next_idx) && game->get_obj(next_idx) == SPACE) {
-                        curr.push(next_idx);
-                        room.insert(next_idx);
-                    }
-                }
+        auto visit = [&](int nx, int ny) {
+            if (is_space(nx, ny) && cell_marks[ny * w + nx] == -1) {
+                cell_marks[ny * w + nx] = room_id;
+                queue[tail++] = ny * w + nx;
             }
-        }
+        };
+
+        visit(x - 1, y);
+        visit(x, y - 1);
+        visit(x, y + 1);
+        visit(x + 1, y);
     }
+
+    return tail;
 }
 
 void RoomGenerator::find_path(int src, int dst, std::vector<int> &path) {
-    std::set<int> covered;
-    std::vector<int> expanded;
-    std::vector<int> parents;
+    prepare_buffers();
 
     if (game->get_obj(src) != SPACE)
         return;
 
-    expanded.push_back(src);
-    parents.push_back(-1);
+    int *queue = search_queue.data();
+    int head = 0;
+    int tail = 0;
+    bool found = false;
 
-    int search_idx = 0;
+    std::fill(cell_marks.begin(), cell_marks.end(), 0);
 
-    while (search_idx < int(expanded.size())) {
-        int curr_idx = expanded[search_idx];
+    cell_marks[src] = 1;
+    parents[src] = -1;
+    queue[tail++] = src;
 
-        if (curr_idx == dst)
-            break;
-        if (game->get_obj(curr_idx) != SPACE)
-            continue;
+    while (head < tail) {
+        int curr_idx = queue[head++];
 
-        int x, y;
-        game->to_grid_xy(curr_idx, &x, &y);
+        if (curr_idx == dst) {
+            found = true;
+            break;
+        }
 
-        for (int i = -1; i <= 1; i++) {
-            for (int j = -1; j <= 1; j++) {
-                if ((i == 0 || j == 0) && (i + j != 0)) {
-                    int next_idx = game->to_grid_idx(x + i, y + j);
+        int x = curr_idx % w;
+        int y = curr_idx / w;
 
-                    if (!set_contains(covered, next_idx) && game->get_obj(next_idx) == SPACE) {
-                        expanded.push_back(next_idx);
-                        parents.push_back(search_idx);
-                        covered.insert(next_idx);
-                    }
-                }
+        // neighbor order determines which of several shortest paths is chosen
+        auto visit = [&](int nx, int ny) {
+            if (is_space(nx, ny) && !cell_marks[ny * w + nx]) {
+                cell_marks[ny * w + nx] = 1;
+                parents[ny * w + nx] = curr_idx;
+                queue[tail++] = ny * w + nx;
             }
-        }
+        };
 
-        search_idx++;
+        visit(x - 1, y);
+        visit(x, y - 1);
+        visit(x, y + 1);
+        visit(x + 1, y);
     }
 
-    if (expanded[search_idx] == dst) {
-        std::vector<int> tmp;
+    if (!found)
+        return;
 
-        while (search_idx >= 0) {
-            tmp.push_back(expanded[search_idx]);
-            search_idx = parents[search_idx];
-        }
+    int path_len = 0;
 
-        for (int j = (int)(tmp.size()) - 1; j >= 0; j--) {
-            path.push_back(tmp[j]);
-        }
+    for (int idx = dst; idx != -1; idx = parents[idx]) {
+        path_len++;
+    }
+
+    size_t start = path.size();
+    path.resize(start + path_len);
+
+    int pos = path_len - 1;
+
+    for (int idx = dst; idx != -1; idx = parents[idx]) {
+        path[start + pos] = idx;
+        pos--;
     }
 }
 
-void RoomGenerator::find_best_room(std::set<int> &best_room) {
-    std::set<int> all_rooms;
-    all_rooms.clear();
+void RoomGenerator::find_best_room(std::vector<int> &best_room) {
+    prepare_buffers();
     best_room.clear();
 
+    std::fill(cell_marks.begin(), cell_marks.end(), -1);
+
+    const int *cells = game->grid.data.data();
+    int best_room_id = -1;
     int best_room_size = -1;
+    int num_rooms = 0;
 
     for (int i = 0; i < game->grid_size; i++) {
-        if (game->get_obj(i) == SPACE && !set_contains(all_rooms, i)) {
-            std::set<int> next_room;
-            build_room(i, next_room);
-            all_rooms.insert(next_room.begin(), next_room.end());
-
-            if (int(next_room.size()) > best_room_size) {
-                best_room_size = (int)(next_room.size());
-                best_room = next_room;
+        if (cells[i] == SPACE && cell_marks[i] == -1) {
+            int room_size = build_room(i, num_rooms);
+
+            // isolated cells have historically been reported as empty rooms
+            if (room_size == 1) {
+                room_size = 0;
+            }
+
+            if (room_size > best_room_size) {
+                best_room_size = room_size;
+                best_room_id = num_rooms;
             }
+
+            num_rooms++;
+        }
+    }
+
+    if (best_room_size <= 0)
+        return;
+
+    best_room.reserve(best_room_size);
+
+    for (int i = 0; i < game->grid_size; i++) {
+        if (cell_marks[i] == best_room_id) {
+            best_room.push_back(i);
         }
     }
 }
 
-void RoomGenerator::expand_room(std::set<int> &set, int n) {
-    std::set<int> curr_set;
-    curr_set.insert(set.begin(), set.end());
+void RoomGenerator::expand_room(std::vector<int> &room, int n) {
+    prepare_buffers();
+
+    const int *cells = game->grid.data.data();
+    int *queue = search_queue.data();
+    int head = 0;
+    int tail = 0;
+
+    std::fill(cell_marks.begin(), cell_marks.end(), 0);
+
+    for (int idx : room) {
+        fassert(game->grid.contains_index(idx));
+
+        if (!cell_marks[idx]) {
+            cell_marks[idx] = 1;
+            queue[tail++] = idx;
+        }
+    }
 
     for (int loop = 0; loop < n; loop++) {
-        std::set<int> next;
+        int layer_end = tail;
+
+        while (head < layer_end) {
+            int curr_idx = queue[head++];
 
-        for (int curr_idx : curr_set) {
-            if (game->get_obj(curr_idx) != SPACE)
+            if (cells[curr_idx] != SPACE)
                 continue;
 
-            int x, y;
-            game->to_grid_xy(curr_idx, &x, &y);
+            int x = curr_idx % w;
+            int y = curr_idx / w;
 
             for (int i = -1; i <= 1; i++) {
                 for (int j = -1; j <= 1; j++) {
-                    if (i != 0 || j != 0) {
-                        int next_idx = game->to_grid_idx(x + i, y + j);
+                    if ((i != 0 || j != 0) && is_space(x + i, y + j)) {
+                        int next_idx = (y + j) * w + (x + i);
 
-                        if (!set_contains(set, next_idx) && game->get_obj(next_idx) == SPACE) {
-                            set.insert(next_idx);
-                            next.insert(next_idx);
+                        if (!cell_marks[next_idx]) {
+                            cell_marks[next_idx] = 1;
+                            queue[tail++] = next_idx;
                         }
                     }
                 }
             }
         }
+    }
+
+    room.clear();
 
-        curr_set = next;
+    for (int i = 0; i < game->grid_size; i++) {
+        if (cell_marks[i]) {
+            room.push_back(i);
+        }
     }
 }
@@ -4,6 +4,9 @@
 
 Cellular-automata based room generation
 
+The automaton and the flood fills run on flat scratch buffers owned by the generator, which are
+sized once per grid and reused between passes, so level generation does not allocate per cell.
+
 */
 
 #include "basic-abstract-game.h"
@@ -15,12 +18,29 @@ class RoomGenerator {
 
     void update();
     void find_path(int src, int dst, std::vector<int> &path);
-    void find_best_room(std::set<int> &best_room);
-    void expand_room(std::set<int> &set, int n);
+    // best_room is filled with the cells of the largest room in ascending order
+    void find_best_room(std::vector<int> &best_room);
+    // room is expanded in place and returned as sorted, unique cell indices
+    void expand_room(std::vector<int> &room, int n);
 
   private:
     BasicAbstractGame *game;
 
-    void build_room(int idx, std::set<int> &room);
-    int count_neighbors(int idx, int type);
-};
\ No newline at end of file
+    int w = 0;
+    int h = 0;
+
+    // padded (w + 2) x (h + 2) wall mask, one byte per cell
+    std::vector<uint8_t> wall_mask;
+    // vertical neighbor counts for a single padded row
+    std::vector<uint8_t> col_counts;
+    // next automaton state, one byte per cell
+    std::vector<uint8_t> next_walls;
+
+    std::vector<int> cell_marks;
+    std::vector<int> parents;
+    std::vector<int> search_queue;
+
+    void prepare_buffers();
+    int build_room(int idx, int room_id);
+    bool is_space(int x, int y);
+};
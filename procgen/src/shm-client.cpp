@@ -0,0 +1,207 @@
+/*
+
+libenv implementation that runs the environment in a procgen_server process
+
+Built as a separate library that exports the same libenv functions as the env library, so it can be
+loaded in its place. libenv_make starts procgen_server and forwards all options to it, except for
+server_path, the path of the procgen_server executable, which defaults to the PROCGEN_SERVER
+environment variable or procgen_server on the PATH.
+
+The server writes observations straight into shared memory, observe copies them to the buffers
+passed to libenv_set_buffers, and act copies the actions the other way. Libenv buffers are owned
+and allocated by the caller, which only passes their addresses to libenv_set_buffers, so the
+shared segment can't take their place and this one copy per observe remains. Linux only.
+
+*/
+
+#include "libenv.h"
+#include "shm-env.h"
+#include "cpp-utils.h"
+#include <atomic>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <fcntl.h>
+#include <spawn.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+extern char **environ;
+
+static std::atomic<int> env_counter(0);
+
+struct ShmClientEnv {
+    int num_envs;
+    pid_t server_pid;
+    ShmEnvHeader *header;
+    uint8_t *data;
+    ShmEnvLayout layout;
+    uint32_t last_response;
+
+    // indexed like the libenv buffers, [space_idx * num_envs + env_idx]
+    std::vector<void *> ob;
+    std::vector<void *> info;
+    std::vector<void *> ac;
+    float *rew = nullptr;
+    uint8_t *first = nullptr;
+};
+
+static void wait_for_response(ShmClientEnv *venv) {
+    while (!shm_futex_wait(&venv->header->response_seq, venv->last_response, 1000)) {
+        int status;
+        if (waitpid(venv->server_pid, &status, WNOHANG) == venv->server_pid) {
+            fatal("procgen_server exited unexpectedly\n");
+        }
+    }
+    venv->last_response = venv->header->response_seq.load();
+}
+
+static void send_command(ShmClientEnv *venv, int command) {
+    venv->header->command = command;
+    venv->header->request_seq++;
+    shm_futex_wake(&venv->header->request_seq);
+    wait_for_response(venv);
+}
+
+// copies the values of every env between the data segment and a set of libenv buffers
+static void copy_space(ShmClientEnv *venv, int space, const std::vector<size_t> &offsets, std::vector<void *> &bufs, bool to_data) {
+    for (size_t i = 0; i < offsets.size(); i++) {
+        size_t size = shm_env_tensortype_size(venv->header->types[space - 1][i]);
+        for (int e = 0; e < venv->num_envs; e++) {
+            uint8_t *shared = venv->data + offsets[i] + e * size;
+            void *buf = bufs[i * venv->num_envs + e];
+            if (to_data) {
+                memcpy(shared, buf, size);
+            } else {
+                memcpy(buf, shared, size);
+            }
+        }
+    }
+}
+
+extern "C" {
+LIBENV_API int libenv_version() {
+    return LIBENV_VERSION;
+}
+
+LIBENV_API libenv_env *libenv_make(int num_envs, const struct libenv_options options) {
+    std::string server_path = getenv("PROCGEN_SERVER") != nullptr ? getenv("PROCGEN_SERVER") : "procgen_server";
+    std::vector<struct libenv_option> forwarded;
+
+    for (int i = 0; i < options.count; i++) {
+        const auto &opt = options.items[i];
+        if (strcmp(opt.name, "server_path") == 0) {
+            fassert(opt.dtype == LIBENV_DTYPE_UINT8);
+            server_path = std::string((char *)(opt.data), opt.count);
+        } else {
+            forwarded.push_back(opt);
+        }
+    }
+
+    std::string control_name = "/procgen-" + std::to_string(getpid()) + "-" + std::to_string(env_counter++);
+    int fd = shm_open(control_name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+    if (fd < 0 || ftruncate(fd, sizeof(ShmEnvHeader)) != 0) {
+        if (fd >= 0) {
+            shm_unlink(control_name.c_str());
+        }
+        fatal("failed to create shared memory segment %s\n", control_name.c_str());
+    }
+    auto header = (ShmEnvHeader *)(mmap(nullptr, sizeof(ShmEnvHeader), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0));
+    close(fd);
+    fassert(header != MAP_FAILED);
+
+    // the segment is zero filled, which is a valid initial state for the atomics
+    header->magic = SHM_ENV_MAGIC;
+    header->num_envs = num_envs;
+    if (!shm_env_write_options(header, forwarded)) {
+        shm_unlink(control_name.c_str());
+        fatal("libenv options are too large for the shared memory header\n");
+    }
+
+    auto venv = new ShmClientEnv();
+    venv->num_envs = num_envs;
+    venv->header = header;
+    venv->last_response = 0;
+
+    std::vector<char *> argv = {(char *)(server_path.c_str()), (char *)(control_name.c_str()), nullptr};
+    if (posix_spawnp(&venv->server_pid, server_path.c_str(), nullptr, nullptr, argv.data(), environ) != 0) {
+        shm_unlink(control_name.c_str());
+        fatal("failed to start %s\n", server_path.c_str());
+    }
+
+    wait_for_response(venv);
+    fassert(header->error == 0);
+
+    // both segments stay mapped after unlinking, so nothing is left behind if either process dies
+    std::string data_name = shm_env_data_name(control_name);
+    venv->layout = shm_env_layout(header);
+    fassert(venv->layout.size == header->data_size);
+    fd = shm_open(data_name.c_str(), O_RDWR, 0600);
+    if (fd < 0) {
+        shm_unlink(data_name.c_str());
+        shm_unlink(control_name.c_str());
+        fatal("failed to open shared memory segment %s\n", data_name.c_str());
+    }
+    venv->data = (uint8_t *)(mmap(nullptr, venv->layout.size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0));
+    close(fd);
+    fassert(venv->data != MAP_FAILED);
+    shm_unlink(data_name.c_str());
+    shm_unlink(control_name.c_str());
+
+    return (libenv_env *)(venv);
+}
+
+LIBENV_API int libenv_get_tensortypes(libenv_env *handle, enum libenv_space_name name, struct libenv_tensortype *out_types) {
+    auto venv = (ShmClientEnv *)(handle);
+    if (name < LIBENV_SPACE_OBSERVATION || name > LIBENV_SPACE_INFO) {
+        return 0;
+    }
+    int count = venv->header->num_types[name - 1];
+    if (out_types != nullptr) {
+        for (int i = 0; i < count; i++) {
+            out_types[i] = venv->header->types[name - 1][i];
+        }
+    }
+    return count;
+}
+
+LIBENV_API void libenv_set_buffers(libenv_env *handle, struct libenv_buffers *bufs) {
+    auto venv = (ShmClientEnv *)(handle);
+    int n = venv->num_envs;
+    venv->ob.assign(bufs->ob, bufs->ob + venv->layout.ob_offsets.size() * n);
+    venv->info.assign(bufs->info, bufs->info + venv->layout.info_offsets.size() * n);
+    venv->ac.assign(bufs->ac, bufs->ac + venv->layout.ac_offsets.size() * n);
+    venv->rew = bufs->rew;
+    venv->first = bufs->first;
+}
+
+LIBENV_API void libenv_observe(libenv_env *handle) {
+    auto venv = (ShmClientEnv *)(handle);
+    send_command(venv, ShmEnvCommandObserve);
+
+    copy_space(venv, LIBENV_SPACE_OBSERVATION, venv->layout.ob_offsets, venv->ob, false);
+    copy_space(venv, LIBENV_SPACE_INFO, venv->layout.info_offsets, venv->info, false);
+    memcpy(venv->rew, venv->data + venv->layout.rew_offset, venv->num_envs * sizeof(float));
+    memcpy(venv->first, venv->data + venv->layout.first_offset, venv->num_envs * sizeof(uint8_t));
+}
+
+LIBENV_API void libenv_act(libenv_env *handle) {
+    auto venv = (ShmClientEnv *)(handle);
+    copy_space(venv, LIBENV_SPACE_ACTION, venv->layout.ac_offsets, venv->ac, true);
+    send_command(venv, ShmEnvCommandAct);
+}
+
+LIBENV_API void libenv_close(libenv_env *handle) {
+    auto venv = (ShmClientEnv *)(handle);
+    send_command(venv, ShmEnvCommandClose);
+
+    int status;
+    waitpid(venv->server_pid, &status, 0);
+
+    munmap(venv->data, venv->layout.size);
+    munmap(venv->header, sizeof(ShmEnvHeader));
+    delete venv;
+}
+}
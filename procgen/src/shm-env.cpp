@@ -0,0 +1,108 @@
+#include "shm-env.h"
+#include "cpp-utils.h"
+#include <cstring>
+#include <ctime>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+static_assert(sizeof(std::atomic<uint32_t>) == sizeof(uint32_t), "futex words must be 32 bits");
+
+static size_t align_up(size_t offset) {
+    return (offset + SHM_ENV_ALIGN - 1) / SHM_ENV_ALIGN * SHM_ENV_ALIGN;
+}
+
+size_t shm_env_tensortype_size(const struct libenv_tensortype &t) {
+    size_t size = t.dtype == LIBENV_DTYPE_UINT8 ? 1 : 4;
+    for (int i = 0; i < t.ndim; i++) {
+        size *= t.shape[i];
+    }
+    return size;
+}
+
+ShmEnvLayout shm_env_layout(const ShmEnvHeader *header) {
+    ShmEnvLayout layout;
+    size_t offset = 0;
+
+    auto add = [&](size_t size) {
+        size_t start = offset;
+        offset = align_up(offset + size * header->num_envs);
+        return start;
+    };
+
+    for (int i = 0; i < header->num_types[LIBENV_SPACE_OBSERVATION - 1]; i++) {
+        layout.ob_offsets.push_back(add(shm_env_tensortype_size(header->types[LIBENV_SPACE_OBSERVATION - 1][i])));
+    }
+    for (int i = 0; i < header->num_types[LIBENV_SPACE_INFO - 1]; i++) {
+        layout.info_offsets.push_back(add(shm_env_tensortype_size(header->types[LIBENV_SPACE_INFO - 1][i])));
+    }
+    for (int i = 0; i < header->num_types[LIBENV_SPACE_ACTION - 1]; i++) {
+        layout.ac_offsets.push_back(add(shm_env_tensortype_size(header->types[LIBENV_SPACE_ACTION - 1][i])));
+    }
+    layout.rew_offset = add(sizeof(float));
+    layout.first_offset = add(sizeof(uint8_t));
+    layout.size = offset;
+
+    return layout;
+}
+
+std::string shm_env_data_name(const std::string &control_name) {
+    return control_name + "-data";
+}
+
+static size_t option_data_size(const struct libenv_option &opt) {
+    return opt.dtype == LIBENV_DTYPE_UINT8 ? opt.count : opt.count * 4;
+}
+
+// each option is stored as the option struct followed by its data
+bool shm_env_write_options(ShmEnvHeader *header, const std::vector<struct libenv_option> &options) {
+    size_t offset = 0;
+
+    for (const auto &opt : options) {
+        size_t size = sizeof(opt) + option_data_size(opt);
+        if (offset + size > SHM_ENV_OPTIONS_SIZE) {
+            return false;
+        }
+        memcpy(header->options + offset, &opt, sizeof(opt));
+        memcpy(header->options + offset + sizeof(opt), opt.data, option_data_size(opt));
+        offset += size;
+    }
+
+    header->num_options = (int32_t)(options.size());
+    return true;
+}
+
+std::vector<struct libenv_option> shm_env_read_options(ShmEnvHeader *header) {
+    std::vector<struct libenv_option> options(header->num_options);
+    size_t offset = 0;
+
+    for (auto &opt : options) {
+        fassert(offset + sizeof(opt) <= SHM_ENV_OPTIONS_SIZE);
+        memcpy(&opt, header->options + offset, sizeof(opt));
+        opt.data = header->options + offset + sizeof(opt);
+        offset += sizeof(opt) + option_data_size(opt);
+        fassert(offset <= SHM_ENV_OPTIONS_SIZE);
+    }
+
+    return options;
+}
+
+bool shm_futex_wait(std::atomic<uint32_t> *word, uint32_t value, int timeout_ms) {
+    if (word->load() != value) {
+        return true;
+    }
+
+    struct timespec timeout;
+    timeout.tv_sec = timeout_ms / 1000;
+    timeout.tv_nsec = (long)(timeout_ms % 1000) * 1000000;
+
+    // not FUTEX_PRIVATE_FLAG since the word is shared between processes, returns immediately if the
+    // word no longer holds value
+    syscall(SYS_futex, (uint32_t *)(word), FUTEX_WAIT, value, &timeout, nullptr, 0);
+
+    return word->load() != value;
+}
+
+void shm_futex_wake(std::atomic<uint32_t> *word) {
+    syscall(SYS_futex, (uint32_t *)(word), FUTEX_WAKE, INT32_MAX, nullptr, nullptr, 0);
+}
@@ -0,0 +1,80 @@
+#pragma once
+
+/*
+
+Shared memory protocol between procgen_server and the shm client library
+
+The client creates a control segment holding a ShmEnvHeader with num_envs and the libenv options,
+then starts procgen_server with the name of the segment. The server creates the VecGame, writes
+its tensortypes to the header and creates a data segment holding the libenv buffers of every env,
+which the VecGame of the server writes to directly.
+
+Commands are lockstep, the client writes a command and increments request_seq, the server runs it
+and increments response_seq. Both sides sleep on these words with futexes. Linux only.
+
+*/
+
+#include "libenv.h"
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+const uint32_t SHM_ENV_MAGIC = 0x70726f63;
+const int SHM_ENV_MAX_TYPES = 16;
+const int SHM_ENV_OPTIONS_SIZE = 1 << 16;
+// buffers in the data segment start on a cache line
+const size_t SHM_ENV_ALIGN = 64;
+
+enum ShmEnvCommand {
+    ShmEnvCommandNone = 0,
+    ShmEnvCommandAct = 1,
+    ShmEnvCommandObserve = 2,
+    ShmEnvCommandClose = 3,
+};
+
+// the spaces are stored in the order of libenv_space_name
+const int SHM_ENV_NUM_SPACES = 3;
+
+struct ShmEnvHeader {
+    uint32_t magic;
+    int32_t num_envs;
+
+    std::atomic<uint32_t> request_seq;
+    std::atomic<uint32_t> response_seq;
+    int32_t command;
+    // set by the server if it could not start
+    int32_t error;
+
+    int32_t num_types[SHM_ENV_NUM_SPACES];
+    struct libenv_tensortype types[SHM_ENV_NUM_SPACES][SHM_ENV_MAX_TYPES];
+    uint64_t data_size;
+
+    int32_t num_options;
+    uint8_t options[SHM_ENV_OPTIONS_SIZE];
+};
+
+// offsets into the data segment, each buffer holds the values of all envs, env by env
+struct ShmEnvLayout {
+    std::vector<size_t> ob_offsets;
+    std::vector<size_t> info_offsets;
+    std::vector<size_t> ac_offsets;
+    size_t rew_offset;
+    size_t first_offset;
+    size_t size;
+};
+
+size_t shm_env_tensortype_size(const struct libenv_tensortype &t);
+ShmEnvLayout shm_env_layout(const ShmEnvHeader *header);
+
+// the data segment is named after the control segment
+std::string shm_env_data_name(const std::string &control_name);
+
+// returns false if the header has no room for the options
+bool shm_env_write_options(ShmEnvHeader *header, const std::vector<struct libenv_option> &options);
+// the returned options point into the header
+std::vector<struct libenv_option> shm_env_read_options(ShmEnvHeader *header);
+
+// sleeps while *word == value, for at most timeout_ms, returns false if the value did not change
+bool shm_futex_wait(std::atomic<uint32_t> *word, uint32_t value, int timeout_ms);
+void shm_futex_wake(std::atomic<uint32_t> *word);
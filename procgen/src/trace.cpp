@@ -0,0 +1,69 @@
+#include "trace.h"
+#include "cpp-utils.h"
+#include <stdio.h>
+
+TraceBuffer::TraceBuffer(int _tid, std::string _thread_name, int capacity)
+    : tid(_tid), thread_name(_thread_name), write_pos(0) {
+    fassert(capacity > 0);
+    events.resize(capacity);
+}
+
+void TraceBuffer::read(std::vector<TraceEvent> &out) const {
+    uint64_t end = write_pos.load(std::memory_order_acquire);
+    uint64_t capacity = events.size();
+    uint64_t start = end > capacity ? end - capacity : 0;
+
+    for (uint64_t pos = start; pos < end; pos++) {
+        out.push_back(events[pos % capacity]);
+    }
+}
+
+static thread_local TraceBuffer *thread_trace_buffer = nullptr;
+
+TraceBuffer *current_trace_buffer() {
+    return thread_trace_buffer;
+}
+
+TraceThreadScope::TraceThreadScope(TraceBuffer *buffer)
+    : prev_buffer(thread_trace_buffer) {
+    thread_trace_buffer = buffer;
+}
+
+TraceThreadScope::~TraceThreadScope() {
+    thread_trace_buffer = prev_buffer;
+}
+
+bool write_chrome_trace(const std::string &path, const std::vector<std::unique_ptr<TraceBuffer>> &buffers, int64_t epoch_ns) {
+    FILE *f = fopen(path.c_str(), "w");
+    if (f == nullptr) {
+        return false;
+    }
+
+    fprintf(f, "{\"displayTimeUnit\": \"ns\", \"traceEvents\": [\n");
+
+    bool first = true;
+    std::vector<TraceEvent> events;
+
+    for (const auto &buffer : buffers) {
+        fprintf(f, "%s{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 0, \"tid\": %d, \"args\": {\"name\": \"%s\"}}", first ? "" : ",\n", buffer->tid, buffer->thread_name.c_str());
+        first = false;
+
+        events.clear();
+        buffer->read(events);
+
+        for (const auto &e : events) {
+            // timestamps are in microseconds
+            double ts = (e.begin_ns - epoch_ns) / 1000.0;
+            double dur = (e.end_ns - e.begin_ns) / 1000.0;
+            fprintf(f, ",\n{\"name\": \"%s\", \"ph\": \"X\", \"pid\": 0, \"tid\": %d, \"ts\": %.3f, \"dur\": %.3f", e.name, buffer->tid, ts, dur);
+            if (e.env_idx >= 0) {
+                fprintf(f, ", \"args\": {\"env\": %d, \"game\": \"%s\"}", e.env_idx, e.game_name != nullptr ? e.game_name : "");
+            }
+            fprintf(f, "}");
+        }
+    }
+
+    fprintf(f, "\n]}\n");
+    fclose(f);
+    return true;
+}
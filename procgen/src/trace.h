@@ -0,0 +1,97 @@
+#pragma once
+
+/*
+
+Opt-in event tracing of the stepping pipeline, written in the Chrome trace event format
+
+Each thread records completed events into its own ring buffer, only the owning thread writes to a
+buffer so recording takes no locks. When a buffer is full the oldest events are overwritten.
+Buffers must only be read while their writer is idle, VecGame does this after waiting for the
+stepping threads.
+
+The output can be loaded in chrome://tracing or https://ui.perfetto.dev
+
+*/
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+struct TraceEvent {
+    const char *name = nullptr;
+    const char *game_name = nullptr;
+    int64_t begin_ns = 0;
+    int64_t end_ns = 0;
+    int env_idx = -1;
+};
+
+inline int64_t trace_clock_ns() {
+    auto t = std::chrono::steady_clock::now().time_since_epoch();
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(t).count();
+}
+
+class TraceBuffer {
+  public:
+    const int tid;
+    const std::string thread_name;
+
+    TraceBuffer(int _tid, std::string _thread_name, int capacity);
+
+    void record(const TraceEvent &event) {
+        uint64_t pos = write_pos.load(std::memory_order_relaxed);
+        events[pos % events.size()] = event;
+        write_pos.store(pos + 1, std::memory_order_release);
+    }
+
+    // oldest to newest
+    void read(std::vector<TraceEvent> &out) const;
+
+  private:
+    std::vector<TraceEvent> events;
+    std::atomic<uint64_t> write_pos;
+};
+
+// the trace buffer of the calling thread, null unless a TraceThreadScope on this thread set one
+TraceBuffer *current_trace_buffer();
+
+// makes buffer the trace buffer of the calling thread for the lifetime of the scope, so code that
+// runs on several threads, like Game, records into the buffer of the thread it is running on
+class TraceThreadScope {
+  public:
+    explicit TraceThreadScope(TraceBuffer *buffer);
+    ~TraceThreadScope();
+
+  private:
+    TraceBuffer *prev_buffer;
+};
+
+// records the lifetime of the scope as a single event, does nothing if buffer is null
+class TraceScope {
+  public:
+    TraceScope(TraceBuffer *_buffer, const char *name, int env_idx = -1, const char *game_name = nullptr)
+        : buffer(_buffer) {
+        if (buffer != nullptr) {
+            event.name = name;
+            event.env_idx = env_idx;
+            event.game_name = game_name;
+            event.begin_ns = trace_clock_ns();
+        }
+    }
+
+    ~TraceScope() {
+        if (buffer != nullptr) {
+            event.end_ns = trace_clock_ns();
+            buffer->record(event);
+        }
+    }
+
+  private:
+    TraceBuffer *buffer;
+    TraceEvent event;
+};
+
+// returns false if the file could not be written
+bool write_chrome_trace(const std::string &path, const std::vector<std::unique_ptr<TraceBuffer>> &buffers, int64_t epoch_ns);
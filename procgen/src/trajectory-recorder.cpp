@@ -0,0 +1,222 @@
+#include "trajectory-recorder.h"
+#include "cpp-utils.h"
+#include <algorithm>
+#include <cstring>
+
+static_assert(sizeof(TrajectoryFileHeader) == 64, "unexpected trajectory header size");
+static_assert(sizeof(TrajectoryChunkHeader) == 32, "unexpected trajectory chunk header size");
+
+static size_t align8(size_t size) {
+    return (size + 7) / 8 * 8;
+}
+
+static inline uint64_t load_block(const uint8_t *p, size_t size) {
+    uint64_t block = 0;
+    memcpy(&block, p, size);
+    return block;
+}
+
+size_t trajectory_encode_ob(const uint8_t *ob, const uint8_t *prev, size_t ob_size, std::vector<uint8_t> &out) {
+    static_assert(TRAJECTORY_BLOCK_SIZE == sizeof(uint64_t), "blocks are compared as uint64");
+
+    size_t num_blocks = (ob_size + TRAJECTORY_BLOCK_SIZE - 1) / TRAJECTORY_BLOCK_SIZE;
+    size_t mask_size = align8((num_blocks + 7) / 8);
+    size_t start = out.size();
+
+    // sized for the worst case and trimmed at the end
+    out.resize(start + mask_size + num_blocks * TRAJECTORY_BLOCK_SIZE);
+    uint8_t *mask = &out[start];
+    memset(mask, 0, mask_size);
+    uint8_t *blocks = mask + mask_size;
+    size_t num_changed = 0;
+
+    for (size_t b = 0; b < num_blocks; b++) {
+        size_t offset = b * TRAJECTORY_BLOCK_SIZE;
+        // the last block is zero padded
+        size_t size = std::min((size_t)TRAJECTORY_BLOCK_SIZE, ob_size - offset);
+        uint64_t block = load_block(ob + offset, size);
+        uint64_t prev_block = prev == nullptr ? 0 : load_block(prev + offset, size);
+        if (block != prev_block) {
+            mask[b / 8] |= (uint8_t)(1 << (b % 8));
+            memcpy(blocks + num_changed * TRAJECTORY_BLOCK_SIZE, &block, TRAJECTORY_BLOCK_SIZE);
+            num_changed++;
+        }
+    }
+
+    size_t size = mask_size + num_changed * TRAJECTORY_BLOCK_SIZE;
+    out.resize(start + size);
+    return size;
+}
+
+TrajectoryRecorder::TrajectoryRecorder(const std::string &path, int _num_envs, const int _ob_shape[3], int _chunk_steps, int _max_queued_chunks) {
+    fassert(_num_envs > 0);
+    fassert(_chunk_steps > 0);
+    fassert(_max_queued_chunks > 0);
+
+    num_envs = _num_envs;
+    chunk_steps = _chunk_steps;
+    max_queued_chunks = _max_queued_chunks;
+    ob_size = 1;
+    for (int i = 0; i < 3; i++) {
+        ob_shape[i] = _ob_shape[i];
+        ob_size *= ob_shape[i];
+    }
+
+    file = fopen(path.c_str(), "wb");
+    if (file == nullptr) {
+        fatal("failed to open trajectory file %s\n", path.c_str());
+    }
+
+    TrajectoryFileHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, TRAJECTORY_MAGIC, sizeof(header.magic));
+    header.version = TRAJECTORY_VERSION;
+    header.num_envs = num_envs;
+    for (int i = 0; i < 3; i++) {
+        header.ob_shape[i] = ob_shape[i];
+    }
+    header.block_size = TRAJECTORY_BLOCK_SIZE;
+    header.chunk_steps = chunk_steps;
+    fassert(fwrite(&header, sizeof(header), 1, file) == 1);
+
+    staging = new_chunk();
+    writer_thread = std::thread(&TrajectoryRecorder::writer_loop, this);
+}
+
+TrajectoryRecorder::~TrajectoryRecorder() {
+    // the step staged by record_observation without actions is dropped
+    if (staging->num_steps > 0) {
+        submit_staging();
+    }
+
+    {
+        std::unique_lock<std::mutex> lock(queue_mutex);
+        closing = true;
+    }
+    queue_changed.notify_all();
+    writer_thread.join();
+
+    fclose(file);
+}
+
+std::unique_ptr<TrajectoryChunk> TrajectoryRecorder::new_chunk() {
+    auto chunk = std::make_unique<TrajectoryChunk>();
+    size_t count = (size_t)(chunk_steps) * num_envs;
+    chunk->actions.resize(count);
+    chunk->rewards.resize(count);
+    chunk->level_seeds.resize(count);
+    chunk->firsts.resize(count);
+    chunk->obs.resize(count * ob_size);
+    return chunk;
+}
+
+void TrajectoryRecorder::record_observation(int env_idx, const uint8_t *ob, float reward, uint8_t first, int32_t level_seed) {
+    size_t i = (size_t)(staging->num_steps) * num_envs + env_idx;
+    memcpy(&staging->obs[i * ob_size], ob, ob_size);
+    staging->rewards[i] = reward;
+    staging->firsts[i] = first;
+    staging->level_seeds[i] = level_seed;
+}
+
+void TrajectoryRecorder::record_action(int env_idx, int32_t action) {
+    staging->actions[(size_t)(staging->num_steps) * num_envs + env_idx] = action;
+}
+
+void TrajectoryRecorder::end_step() {
+    staging->num_steps++;
+    if (staging->num_steps == chunk_steps) {
+        submit_staging();
+    }
+}
+
+void TrajectoryRecorder::submit_staging() {
+    std::unique_ptr<TrajectoryChunk> next;
+    {
+        std::unique_lock<std::mutex> lock(queue_mutex);
+        queue_changed.wait(lock, [&]() { return queued_chunks.size() < max_queued_chunks; });
+        queued_chunks.push_back(std::move(staging));
+        if (!free_chunks.empty()) {
+            next = std::move(free_chunks.back());
+            free_chunks.pop_back();
+        }
+    }
+    queue_changed.notify_all();
+
+    if (next == nullptr) {
+        next = new_chunk();
+    }
+    next->num_steps = 0;
+    staging = std::move(next);
+}
+
+void TrajectoryRecorder::writer_loop() {
+    std::vector<uint8_t> encoded;
+
+    while (true) {
+        std::unique_ptr<TrajectoryChunk> chunk;
+        {
+            std::unique_lock<std::mutex> lock(queue_mutex);
+            queue_changed.wait(lock, [&]() { return closing || !queued_chunks.empty(); });
+            if (queued_chunks.empty()) {
+                return;
+            }
+            chunk = std::move(queued_chunks.front());
+            queued_chunks.pop_front();
+        }
+        // there is room in the queue again
+        queue_changed.notify_all();
+
+        write_chunk(*chunk, encoded);
+
+        {
+            std::unique_lock<std::mutex> lock(queue_mutex);
+            free_chunks.push_back(std::move(chunk));
+        }
+    }
+}
+
+void TrajectoryRecorder::write_chunk(const TrajectoryChunk &chunk, std::vector<uint8_t> &encoded) {
+    size_t count = (size_t)(chunk.num_steps) * num_envs;
+
+    encoded.clear();
+    std::vector<uint64_t> ob_offsets(count + 1);
+    for (int t = 0; t < chunk.num_steps; t++) {
+        for (int e = 0; e < num_envs; e++) {
+            size_t i = (size_t)(t) * num_envs + e;
+            const uint8_t *prev = t == 0 ? nullptr : &chunk.obs[(i - num_envs) * ob_size];
+            ob_offsets[i] = encoded.size();
+            trajectory_encode_ob(&chunk.obs[i * ob_size], prev, ob_size, encoded);
+        }
+    }
+    ob_offsets[count] = encoded.size();
+
+    std::vector<std::pair<const void *, size_t>> sections = {
+        {chunk.actions.data(), count * sizeof(int32_t)},
+        {chunk.rewards.data(), count * sizeof(float)},
+        {chunk.level_seeds.data(), count * sizeof(int32_t)},
+        {chunk.firsts.data(), count * sizeof(uint8_t)},
+        {ob_offsets.data(), ob_offsets.size() * sizeof(uint64_t)},
+        {encoded.data(), encoded.size()},
+    };
+
+    TrajectoryChunkHeader header;
+    memset(&header, 0, sizeof(header));
+    header.magic = TRAJECTORY_CHUNK_MAGIC;
+    header.num_steps = chunk.num_steps;
+    header.chunk_size = sizeof(header);
+    for (const auto &section : sections) {
+        header.chunk_size += align8(section.second);
+    }
+    header.ob_data_size = encoded.size();
+
+    const uint8_t zeros[8] = {0};
+    bool ok = fwrite(&header, sizeof(header), 1, file) == 1;
+    for (const auto &section : sections) {
+        size_t padding = align8(section.second) - section.second;
+        ok = ok && fwrite(section.first, 1, section.second, file) == section.second;
+        ok = ok && fwrite(zeros, 1, padding, file) == padding;
+    }
+    if (!ok || fflush(file) != 0) {
+        fatal("failed to write trajectory chunk\n");
+    }
+}
@@ -0,0 +1,112 @@
+#pragma once
+
+/*
+
+Streams the steps of a VecGame to a chunked trajectory file on a background writer thread
+
+Each recorded step holds, for every env, the observation and the reward, first and level_seed that
+were observed with it, and the action that was taken after it. The stepping side only copies the
+step into a staging chunk, full chunks are handed to the writer thread, which encodes and appends
+them to the file. If the writer falls behind by more than max_queued_chunks the caller waits.
+
+The file is meant to be memory mapped (see procgen/trajectory.py), all values are little endian
+and every section starts on an 8 byte boundary:
+
+    TrajectoryFileHeader
+    chunks, each made of
+        TrajectoryChunkHeader
+        int32 action[num_steps][num_envs]
+        float reward[num_steps][num_envs]
+        int32 level_seed[num_steps][num_envs]
+        uint8 first[num_steps][num_envs]
+        uint64 ob_offsets[num_steps * num_envs + 1], into the encoded observations, step major
+        uint8 encoded observations
+
+Observations are split into blocks of TRAJECTORY_BLOCK_SIZE bytes and encoded against the previous
+observation of the same env as a bitmask of changed blocks followed by the changed blocks. The
+first step of every chunk is encoded against an all zero observation so chunks decode
+independently.
+
+*/
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <stdio.h>
+#include <string>
+#include <thread>
+#include <vector>
+
+const char TRAJECTORY_MAGIC[8] = {'P', 'G', 'T', 'R', 'A', 'J', '0', '1'};
+const uint32_t TRAJECTORY_CHUNK_MAGIC = 0x4b4e4843;
+const int TRAJECTORY_VERSION = 1;
+const int TRAJECTORY_BLOCK_SIZE = 8;
+
+struct TrajectoryFileHeader {
+    char magic[8];
+    int32_t version;
+    int32_t num_envs;
+    int32_t ob_shape[3];
+    int32_t block_size;
+    int32_t chunk_steps;
+    int32_t padding[7];
+};
+
+struct TrajectoryChunkHeader {
+    uint32_t magic;
+    int32_t num_steps;
+    // including this header
+    uint64_t chunk_size;
+    uint64_t ob_data_size;
+    uint64_t padding;
+};
+
+struct TrajectoryChunk {
+    int num_steps = 0;
+    std::vector<int32_t> actions;
+    std::vector<float> rewards;
+    std::vector<int32_t> level_seeds;
+    std::vector<uint8_t> firsts;
+    std::vector<uint8_t> obs;
+};
+
+class TrajectoryRecorder {
+  public:
+    TrajectoryRecorder(const std::string &path, int _num_envs, const int _ob_shape[3], int _chunk_steps, int _max_queued_chunks = 2);
+    // flushes the steps recorded so far
+    ~TrajectoryRecorder();
+
+    // stages the observation half of the current step, a later call for the same env replaces it
+    void record_observation(int env_idx, const uint8_t *ob, float reward, uint8_t first, int32_t level_seed);
+    // completes the current step once every env has an action
+    void record_action(int env_idx, int32_t action);
+    void end_step();
+
+  private:
+    int num_envs;
+    int ob_shape[3];
+    size_t ob_size;
+    int chunk_steps;
+    size_t max_queued_chunks;
+    FILE *file;
+
+    std::unique_ptr<TrajectoryChunk> staging;
+
+    std::mutex queue_mutex;
+    std::condition_variable queue_changed;
+    std::deque<std::unique_ptr<TrajectoryChunk>> queued_chunks;
+    // chunks the writer is done with, reused to avoid reallocating the staging buffers
+    std::vector<std::unique_ptr<TrajectoryChunk>> free_chunks;
+    bool closing = false;
+    std::thread writer_thread;
+
+    std::unique_ptr<TrajectoryChunk> new_chunk();
+    void submit_staging();
+    void writer_loop();
+    void write_chunk(const TrajectoryChunk &chunk, std::vector<uint8_t> &encoded);
+};
+
+// appends ob encoded against prev to out, returns the number of bytes written
+size_t trajectory_encode_ob(const uint8_t *ob, const uint8_t *prev, size_t ob_size, std::vector<uint8_t> &out);
@@ -3,6 +3,17 @@
 #include "vecoptions.h"
 #include "game.h"
 
+#include <chrono>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
 const int32_t END_OF_BUFFER = 0xCAFECAFE;
 
 extern void coinrun_old_init(int rand_seed);
@@ -24,6 +35,51 @@ std::vector<std::string> split(std::string s, std::string delimiter) {
     return env_names;
 }
 
+// parses a core list such as "0-7,16-23"
+std::vector<int> parse_core_list(std::string s) {
+    std::vector<int> cores;
+
+    for (const auto &token : split(s, ",")) {
+        size_t dash = token.find("-");
+        int first = std::stoi(token.substr(0, dash));
+        int last = dash == std::string::npos ? first : std::stoi(token.substr(dash + 1));
+        fassert(first >= 0 && first <= last);
+        for (int c = first; c <= last; c++) {
+            cores.push_back(c);
+        }
+    }
+
+    return cores;
+}
+
+// pinning is only supported on linux, elsewhere this does nothing
+static void pin_current_thread(int core) {
+    if (core < 0) {
+        return;
+    }
+#ifdef __linux__
+    cpu_set_t cpus;
+    CPU_ZERO(&cpus);
+    CPU_SET(core, &cpus);
+    if (pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus) != 0) {
+        fatal("failed to pin thread to core %d\n", core);
+    }
+#endif
+}
+
+static inline void cpu_relax() {
+#if defined(__x86_64__) || defined(__i386__)
+    _mm_pause();
+#elif defined(__aarch64__)
+    __asm__ __volatile__("yield");
+#endif
+}
+
+static inline int64_t steady_clock_ns() {
+    auto t = std::chrono::steady_clock::now().time_since_epoch();
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(t).count();
+}
+
 // libenv api
 
 // convert_bufs reorganizes buffers so that they are indexed by the environment
@@ -100,47 +156,6 @@ void libenv_close(libenv_env *handle) {
 
 // end libenv api
 
-static void stepping_worker(std::mutex &stepping_thread_mutex,
-                            std::list<std::shared_ptr<Game>> &pending_games,
-                            std::condition_variable &pending_games_added,
-                            std::condition_variable &pending_game_complete, bool &time_to_die) {
-    while (1) {
-        std::shared_ptr<Game> game;
-
-        {
-            std::unique_lock<std::mutex> lock(stepping_thread_mutex);
-            while (1) {
-                if (time_to_die) {
-                    return;
-                }
-                if (!pending_games.empty()) {
-                    game = pending_games.front();
-                    pending_games.pop_front();
-                    break;
-                }
-
-                pending_games_added.wait(lock);
-            }
-        }
-
-        // the first time the threads are activated is before any step, just to initialize
-        // the environment and produce the initial observation
-        if (!game->initial_reset_complete) {
-            game->reset();
-            game->observe();
-            game->initial_reset_complete = true;
-        } else{
-            game->step();
-        }
-
-        {
-            std::unique_lock<std::mutex> lock(stepping_thread_mutex);
-            game->is_waiting_for_step = false;
-            pending_game_complete.notify_all();
-        }
-    }
-}
-
 void global_init(int rand_seed, std::string resource_root) {
     global_resource_root = resource_root;
 
@@ -168,6 +183,8 @@ inline uint32_t hash_str_uint32(const std::string &str) {
 
 VecGame::VecGame(int _nenvs, VecOptions opts) {
     render_human = false;
+    phase_timing = false;
+    tracing = false;
     num_envs = _nenvs;
     games.resize(num_envs);
     std::string env_name;
@@ -178,7 +195,22 @@ VecGame::VecGame(int _nenvs, VecOptions opts) {
 
     int rand_seed = 0;
     int num_threads = 4;
+    num_groups = 1;
+    batch_size = 0;
+    partition_envs = false;
+    static_partition = false;
+    spin_wait_us = 0;
+    work_epoch = 0;
+    completion_epoch = 0;
+    int trace_buffer_size = 1 << 16;
+    std::string record_path;
+    std::string action_log_path;
+    int record_chunk_steps = 32;
     std::string resource_root;
+    std::string thread_affinity;
+
+    // copied before consuming any options, for the action log
+    std::vector<libenv_option> all_options = opts.items();
 
     opts.consume_string("env_name", &env_name);
     opts.consume_int("num_levels", &num_levels);
@@ -187,21 +219,66 @@ VecGame::VecGame(int _nenvs, VecOptions opts) {
     opts.consume_int("rand_seed", &rand_seed);
     opts.consume_int("num_threads", &num_threads);
     opts.consume_string("resource_root", &resource_root);
+    opts.consume_int("num_groups", &num_groups);
+    opts.consume_int("batch_size", &batch_size);
+    opts.consume_string("thread_affinity", &thread_affinity);
+    opts.consume_bool("partition_envs", &partition_envs);
+    opts.consume_bool("static_partition", &static_partition);
+    opts.consume_int("spin_wait_us", &spin_wait_us);
     opts.consume_bool("render_human", &render_human);
+    opts.consume_bool("phase_timing", &phase_timing);
+    opts.consume_bool("tracing", &tracing);
+    opts.consume_string("trace_path", &trace_path);
+    opts.consume_int("trace_buffer_size", &trace_buffer_size);
+    opts.consume_string("record_path", &record_path);
+    opts.consume_int("record_chunk_steps", &record_chunk_steps);
+    opts.consume_string("action_log_path", &action_log_path);
 
     std::call_once(global_init_flag, global_init, rand_seed,
                    resource_root);
 
     fassert(num_threads >= 0);
+    fassert(batch_size >= 0 && batch_size <= num_envs);
+    ready_queue.init(num_envs);
+
+    if (thread_affinity != "") {
+        thread_cores = parse_core_list(thread_affinity);
+    }
+
+    if (static_partition) {
+        partition_envs = true;
+    }
+
+    if (num_threads == 0) {
+        partition_envs = false;
+        static_partition = false;
+    }
+
+    pending_games.resize(partition_envs ? num_threads : 1);
+    env_thread.resize(num_envs);
+    for (int n = 0; n < num_envs; n++) {
+        env_thread[n] = partition_envs ? (int)((int64_t)(n) * num_threads / num_envs) : -1;
+    }
+
+    if (phase_timing) {
+        thread_phase_stats.resize(num_threads > 0 ? num_threads : 1);
+    }
+
+    if (trace_path != "") {
+        tracing = true;
+    }
+
+    if (tracing) {
+        trace_epoch_ns = trace_clock_ns();
+        trace_buffers.push_back(std::make_unique<TraceBuffer>(0, "caller", trace_buffer_size));
+        for (int t = 0; t < num_threads; t++) {
+            trace_buffers.push_back(std::make_unique<TraceBuffer>(t + 1, "stepping_worker " + std::to_string(t), trace_buffer_size));
+        }
+    }
+
     threads.resize(num_threads);
     for (int t = 0; t < num_threads; t++) {
-        threads[t] = std::thread(
-            stepping_worker,
-            std::ref(stepping_thread_mutex),
-            std::ref(pending_games),
-            std::ref(pending_games_added),
-            std::ref(pending_game_complete),
-            std::ref(time_to_die));
+        threads[t] = std::thread(&VecGame::stepping_worker, this, t);
     }
 
     fassert(env_name != "");
@@ -267,6 +344,19 @@ VecGame::VecGame(int _nenvs, VecOptions opts) {
         info_types.push_back(s);
     }
     
+    if (phase_timing) {
+        for (int p = 0; p < NUM_PHASES; p++) {
+            struct libenv_tensortype s;
+            strcpy(s.name, PHASE_INFO_NAMES[p]);
+            s.scalar_type = LIBENV_SCALAR_TYPE_DISCRETE;
+            s.dtype = LIBENV_DTYPE_INT32;
+            s.ndim = 0,
+            s.low.int32 = 0;
+            s.high.int32 = INT32_MAX;
+            info_types.push_back(s);
+        }
+    }
+
     if (render_human) {
         struct libenv_tensortype s;
         strcpy(s.name, "rgb");
@@ -281,6 +371,15 @@ VecGame::VecGame(int _nenvs, VecOptions opts) {
         info_types.push_back(s);
     }
 
+    if (record_path != "") {
+        const int ob_shape[3] = {RES_W, RES_H, 3};
+        recorder = std::make_unique<TrajectoryRecorder>(record_path, num_envs, ob_shape, record_chunk_steps);
+    }
+
+    if (action_log_path != "") {
+        action_log = std::make_unique<ActionLogWriter>(action_log_path, num_envs, all_options);
+    }
+
     int level_seed_low = 0;
     int level_seed_high = 0;
 
@@ -297,6 +396,7 @@ VecGame::VecGame(int _nenvs, VecOptions opts) {
     num_joint_games = (int)(env_names.size());
 
     fassert(num_envs % num_joint_games == 0);
+    fassert(num_groups > 0 && num_envs % num_groups == 0);
 
     RandGen game_level_seed_gen;
     game_level_seed_gen.seed(rand_seed);
@@ -306,19 +406,33 @@ VecGame::VecGame(int _nenvs, VecOptions opts) {
         info_name_to_offset[info_types[i].name] = i;
     }
 
+    // drawn up front so that the seeds don't depend on the order the games are created in
+    std::vector<int> level_seeds(num_envs);
     for (int n = 0; n < num_envs; n++) {
+        level_seeds[n] = game_level_seed_gen.randint();
+    }
+
+    auto create_game = [&](int n) {
         auto name = env_names[n % num_joint_games];
 
         games[n] = globalGameRegistry->at(name)();
         fassert(games[n]->game_name == name);
-        games[n]->level_seed_rand_gen.seed(game_level_seed_gen.randint());
         games[n]->level_seed_high = level_seed_high;
         games[n]->level_seed_low = level_seed_low;
         games[n]->game_n = n;
         games[n]->is_waiting_for_step = false;
         games[n]->parse_options(name, opts);
+        // seeded after parsing options since the generator type is an option
+        games[n]->level_seed_rand_gen.seed(level_seeds[n]);
         games[n]->info_name_to_offset = info_name_to_offset;
 
+        if (phase_timing) {
+            games[n]->phase_stats = std::make_unique<PhaseStats>();
+            if (num_threads == 0) {
+                games[n]->thread_phase_stats = &thread_phase_stats[0];
+            }
+        }
+
         // Auto-selected a fixed_asset_seed if one wasn't specified on
         // construction
         if (games[n]->fixed_asset_seed == 0) {
@@ -327,10 +441,35 @@ VecGame::VecGame(int _nenvs, VecOptions opts) {
         }
 
         games[n]->game_init();
+    };
+
+    if (partition_envs) {
+        // create each partition on a thread pinned like its stepping thread, so that the memory of the
+        // games is first touched, and with a NUMA first touch policy allocated, on that thread's node
+        std::vector<std::thread> init_threads(num_threads);
+        for (int t = 0; t < num_threads; t++) {
+            init_threads[t] = std::thread([&, t]() {
+                pin_current_thread(thread_cores.empty() ? -1 : thread_cores[t % thread_cores.size()]);
+                int begin, end;
+                get_thread_range(t, &begin, &end);
+                for (int n = begin; n < end; n++) {
+                    create_game(n);
+                }
+            });
+        }
+        for (auto &t : init_threads) {
+            t.join();
+        }
+    } else {
+        for (int n = 0; n < num_envs; n++) {
+            create_game(n);
+        }
     }
 }
 
 void VecGame::set_buffers(const std::vector<std::vector<void *>> &ac, const std::vector<std::vector<void *>> &ob, const std::vector<std::vector<void *>> &info, float *rew, uint8_t *first) {
+    // without stepping threads the initial reset runs here
+    TraceThreadScope thread_trace(caller_trace_buffer());
     {
         std::unique_lock<std::mutex> lock(stepping_thread_mutex);
 
@@ -351,37 +490,260 @@ void VecGame::set_buffers(const std::vector<std::vector<void *>> &ac, const std:
                 game->reset();
                 game->observe();
                 game->initial_reset_complete = true;
+                if (batch_size > 0) {
+                    ready_queue.push(e);
+                }
             } else {
                 game->is_waiting_for_step = true;
-                pending_games.push_back(game);
+                if (!static_partition) {
+                    pending_games_for(e).push_back(game);
+                }
             }
         }
+
+        if (static_partition) {
+            batch_generation++;
+        }
     }
+    notify_work_added();
+}
+
+void VecGame::stepping_worker(int thread_idx) {
+    pin_current_thread(thread_cores.empty() ? -1 : thread_cores[thread_idx % thread_cores.size()]);
+    TraceThreadScope thread_trace(tracing ? trace_buffers[thread_idx + 1].get() : nullptr);
+
+    auto &thread_pending_games = pending_games[partition_envs ? thread_idx : 0];
+    int64_t seen_batch_generation = 0;
+
+    while (1) {
+        std::shared_ptr<Game> game;
+        bool step_batch = false;
+        int64_t spin_deadline_ns = 0;
+
+        {
+            std::unique_lock<std::mutex> lock(stepping_thread_mutex);
+            while (1) {
+                if (time_to_die) {
+                    return;
+                }
+                if (!thread_pending_games.empty()) {
+                    game = thread_pending_games.front();
+                    thread_pending_games.pop_front();
+                    break;
+                }
+                if (batch_generation != seen_batch_generation) {
+                    seen_batch_generation = batch_generation;
+                    step_batch = true;
+                    break;
+                }
+
+                if (!spin_wait(lock, work_epoch, &spin_deadline_ns)) {
+                    pending_games_added.wait(lock);
+                }
+            }
+        }
+
+        if (step_batch) {
+            // every game of the range was marked as waiting for a step when the batch was started
+            int begin, end;
+            get_thread_range(thread_idx, &begin, &end);
+
+            for (int e = begin; e < end; e++) {
+                step_game(games[e], thread_idx);
+            }
+
+            std::unique_lock<std::mutex> lock(stepping_thread_mutex);
+            for (int e = begin; e < end; e++) {
+                games[e]->is_waiting_for_step = false;
+                if (batch_size > 0) {
+                    ready_queue.push(e);
+                }
+            }
+            notify_game_complete();
+        } else {
+            step_game(game, thread_idx);
+
+            std::unique_lock<std::mutex> lock(stepping_thread_mutex);
+            game->is_waiting_for_step = false;
+            if (batch_size > 0) {
+                ready_queue.push(game->game_n);
+            }
+            notify_game_complete();
+        }
+    }
+}
+
+void VecGame::step_game(const std::shared_ptr<Game> &game, int thread_idx) {
+    TraceBuffer *trace_buffer = current_trace_buffer();
+
+    game->thread_phase_stats = phase_timing ? &thread_phase_stats[thread_idx] : nullptr;
+
+    if (rollout_job != nullptr) {
+        TraceScope trace(trace_buffer, "rollout", game->game_n, game->game_name.c_str());
+        run_rollout(game.get());
+        return;
+    }
+
+    TraceScope trace(trace_buffer, game->initial_reset_complete ? "step" : "initial_reset", game->game_n, game->game_name.c_str());
+
+    // the first time the threads are activated is before any step, just to initialize
+    // the environment and produce the initial observation
+    if (!game->initial_reset_complete) {
+        game->reset();
+        game->observe();
+        game->initial_reset_complete = true;
+    } else{
+        game->step();
+    }
+}
+
+void VecGame::get_thread_range(int thread_idx, int *begin, int *end) {
+    // the envs n with env_thread[n] == thread_idx
+    int num_threads = (int)(threads.size());
+    *begin = (int)(((int64_t)(thread_idx) * num_envs + num_threads - 1) / num_threads);
+    *end = (int)(((int64_t)(thread_idx + 1) * num_envs + num_threads - 1) / num_threads);
+}
+
+void VecGame::notify_work_added() {
+    work_epoch++;
     pending_games_added.notify_all();
 }
 
+void VecGame::notify_game_complete() {
+    completion_epoch++;
+    pending_game_complete.notify_all();
+}
+
+// with spin_wait_us set, releases the lock and spins until epoch changes or the deadline passes, the
+// deadline is set on the first call, returns false once the caller should sleep on its condition variable
+bool VecGame::spin_wait(std::unique_lock<std::mutex> &lock, const std::atomic<uint64_t> &epoch, int64_t *spin_deadline_ns) {
+    if (spin_wait_us <= 0) {
+        return false;
+    }
+
+    int64_t now = steady_clock_ns();
+    if (*spin_deadline_ns == 0) {
+        *spin_deadline_ns = now + (int64_t)(spin_wait_us) * 1000;
+    }
+    if (now >= *spin_deadline_ns) {
+        return false;
+    }
+
+    uint64_t seen_epoch = epoch.load();
+    lock.unlock();
+
+    for (int i = 1; epoch.load(std::memory_order_relaxed) == seen_epoch; i++) {
+        cpu_relax();
+        // reading the clock costs more than a pause
+        if (i % 64 == 0 && steady_clock_ns() >= *spin_deadline_ns) {
+            break;
+        }
+    }
+
+    lock.lock();
+    return true;
+}
+
+std::list<std::shared_ptr<Game>> &VecGame::pending_games_for(int env_idx) {
+    return pending_games[partition_envs ? env_thread[env_idx] : 0];
+}
+
+TraceBuffer *VecGame::caller_trace_buffer() {
+    return tracing ? trace_buffers[0].get() : nullptr;
+}
+
+PhaseStats *VecGame::caller_phase_stats() {
+    return phase_timing && threads.size() == 0 ? &thread_phase_stats[0] : nullptr;
+}
+
 void VecGame::observe() {
-    wait_for_stepping_threads();
-    // at this point all games belong to the python thread
+    TraceScope trace(caller_trace_buffer(), "libenv_observe");
+    observe_envs(0, num_envs);
+
+    if (recorder != nullptr) {
+        for (int e = 0; e < num_envs; e++) {
+            const auto &game = games[e];
+            auto level_seed = (int32_t *)(game->info_bufs[game->info_name_to_offset.at("level_seed")]);
+            recorder->record_observation(e, (uint8_t *)(game->obs_bufs[0]), *game->reward_ptr, *game->first_ptr, *level_seed);
+        }
+    }
+}
+
+void VecGame::act() {
+    TraceScope trace(caller_trace_buffer(), "libenv_act");
+
+    if (recorder != nullptr) {
+        for (int e = 0; e < num_envs; e++) {
+            recorder->record_action(e, *games[e]->action_ptr);
+        }
+        recorder->end_step();
+    }
+
+    if (action_log != nullptr) {
+        std::vector<int32_t> actions(num_envs);
+        for (int e = 0; e < num_envs; e++) {
+            actions[e] = *games[e]->action_ptr;
+        }
+        action_log->write_actions(actions);
+    }
+
+    act_envs(0, num_envs);
+}
+
+void VecGame::observe_group(int group) {
+    TraceScope trace(caller_trace_buffer(), "observe_group");
+    int begin, end;
+    get_group_range(group, &begin, &end);
+    observe_envs(begin, end);
+}
+
+void VecGame::act_group(int group) {
+    TraceScope trace(caller_trace_buffer(), "act_group");
+    // the recorders only record full steps
+    fassert(recorder == nullptr && action_log == nullptr);
+    int begin, end;
+    get_group_range(group, &begin, &end);
+    act_envs(begin, end);
+}
+
+void VecGame::get_group_range(int group, int *begin, int *end) {
+    fassert(group >= 0 && group < num_groups);
+    int group_size = num_envs / num_groups;
+    *begin = group * group_size;
+    *end = *begin + group_size;
+}
+
+void VecGame::observe_envs(int begin, int end) {
+    wait_for_stepping_threads(begin, end);
+    // at this point these games belong to the python thread
 
     if (render_human) {
         uint8_t render_hires_buf[RENDER_RES * RENDER_RES * 4];
 
-        for (int e = 0; e < num_envs; e++) {
+        for (int e = begin; e < end; e++) {
             const auto &game = games[e];
+            TraceScope render_trace(caller_trace_buffer(), "render_human", e, game->game_name.c_str());
             game->render_to_buf(render_hires_buf, RENDER_RES, RENDER_RES, true);
             bgr32_to_rgb888(game->info_bufs[game->info_name_to_offset.at("rgb")], render_hires_buf, RENDER_RES, RENDER_RES);
         }
     }
 }
 
-void VecGame::act() {
-    wait_for_stepping_threads();
+void VecGame::act_envs(int begin, int end) {
+    TraceThreadScope thread_trace(caller_trace_buffer());
+    wait_for_stepping_threads(begin, end);
 
     {
         std::unique_lock<std::mutex> lock(stepping_thread_mutex);
 
-        for (int e = 0; e < num_envs; e++) {
+        if (batch_size > 0) {
+            ready_queue.remove_range(begin, end);
+        }
+
+        // partial ranges are queued per env
+        bool start_batch = static_partition && begin == 0 && end == num_envs;
+
+        for (int e = begin; e < end; e++) {
             const auto &game = games[e];
             fassert(!game->is_waiting_for_step);
             // save the action since it's only valid for the duration of this call
@@ -389,15 +751,341 @@ void VecGame::act() {
             if (threads.size() == 0) {
                 // special case for no threads
                 game->step();
+                if (batch_size > 0) {
+                    ready_queue.push(e);
+                }
+            } else {
+                game->is_waiting_for_step = true;
+                if (!start_batch) {
+                    pending_games_for(e).push_back(game);
+                }
+            }
+        }
+
+        if (start_batch) {
+            batch_generation++;
+        }
+    }
+    // at this point these games belong to the stepping threads
+
+    notify_work_added();
+}
+
+void VecGame::observe_ready(int32_t *env_ids) {
+    TraceScope trace(caller_trace_buffer(), "observe_ready");
+    fassert(batch_size > 0);
+
+    {
+        std::unique_lock<std::mutex> lock(stepping_thread_mutex);
+
+        if (ready_queue.size() < batch_size) {
+            int num_stepping = 0;
+            for (const auto &game : games) {
+                num_stepping += game->is_waiting_for_step ? 1 : 0;
+            }
+            // otherwise we would wait forever for envs that are not stepping
+            fassert(ready_queue.size() + num_stepping >= batch_size);
+
+            TraceScope wait_trace(caller_trace_buffer(), "wait_for_ready_envs");
+            int64_t spin_deadline_ns = 0;
+            while (ready_queue.size() < batch_size) {
+                if (!spin_wait(lock, completion_epoch, &spin_deadline_ns)) {
+                    pending_game_complete.wait(lock);
+                }
+            }
+        }
+
+        for (int i = 0; i < batch_size; i++) {
+            env_ids[i] = ready_queue.pop();
+        }
+    }
+    // at this point the returned games belong to the python thread
+
+    if (render_human) {
+        uint8_t render_hires_buf[RENDER_RES * RENDER_RES * 4];
+
+        for (int i = 0; i < batch_size; i++) {
+            const auto &game = games[env_ids[i]];
+            TraceScope render_trace(caller_trace_buffer(), "render_human", env_ids[i], game->game_name.c_str());
+            game->render_to_buf(render_hires_buf, RENDER_RES, RENDER_RES, true);
+            bgr32_to_rgb888(game->info_bufs[game->info_name_to_offset.at("rgb")], render_hires_buf, RENDER_RES, RENDER_RES);
+        }
+    }
+}
+
+void VecGame::act_ready(const int32_t *env_ids, int count) {
+    TraceThreadScope thread_trace(caller_trace_buffer());
+    TraceScope trace(caller_trace_buffer(), "act_ready");
+    fassert(batch_size > 0);
+    fassert(recorder == nullptr && action_log == nullptr);
+
+    {
+        std::unique_lock<std::mutex> lock(stepping_thread_mutex);
+
+        // envs are normally acted on after observe_ready returned them, but they may also still be queued
+        ready_queue.remove(env_ids, count);
+
+        for (int i = 0; i < count; i++) {
+            int e = env_ids[i];
+            fassert(e >= 0 && e < num_envs);
+            const auto &game = games[e];
+            fassert(!game->is_waiting_for_step);
+            game->action = *game->action_ptr;
+            if (threads.size() == 0) {
+                game->step();
+                ready_queue.push(e);
             } else {
                 game->is_waiting_for_step = true;
-                pending_games.push_back(game);
+                pending_games_for(e).push_back(game);
             }
         }
     }
-    // at this point all games belong to the stepping threads
 
-    pending_games_added.notify_all();
+    notify_work_added();
+}
+
+static size_t tensortype_size(const struct libenv_tensortype &t) {
+    size_t size = t.dtype == LIBENV_DTYPE_UINT8 ? 1 : 4;
+    for (int i = 0; i < t.ndim; i++) {
+        size *= t.shape[i];
+    }
+    return size;
+}
+
+void VecGame::rollout(int num_steps, int policy, int seed, const struct libenv_buffers *bufs) {
+    TraceThreadScope thread_trace(caller_trace_buffer());
+    TraceScope trace(caller_trace_buffer(), "libenv_rollout");
+    fassert(num_steps > 0);
+    fassert(policy >= RolloutPolicyRandom && policy <= RolloutPolicyScripted);
+    fassert(policy != RolloutPolicyScripted || (bufs->ac != nullptr && bufs->ac[0] != nullptr));
+    // the human render is done on the calling thread in observe
+    fassert(!render_human);
+    fassert(recorder == nullptr && action_log == nullptr);
+
+    wait_for_stepping_threads();
+
+    RolloutJob job;
+    job.num_steps = num_steps;
+    job.policy = policy;
+    job.bufs = bufs;
+    for (const auto &t : observation_types) {
+        job.ob_sizes.push_back(tensortype_size(t));
+    }
+    for (const auto &t : info_types) {
+        job.info_sizes.push_back(tensortype_size(t));
+    }
+
+    RandGen policy_seed_gen;
+    policy_seed_gen.seed(seed);
+    job.policy_seeds.resize(num_envs);
+    for (int e = 0; e < num_envs; e++) {
+        job.policy_seeds[e] = policy_seed_gen.randint();
+    }
+
+    {
+        std::unique_lock<std::mutex> lock(stepping_thread_mutex);
+        rollout_job = &job;
+
+        if (batch_size > 0) {
+            ready_queue.remove_range(0, num_envs);
+        }
+
+        for (int e = 0; e < num_envs; e++) {
+            const auto &game = games[e];
+            fassert(!game->is_waiting_for_step);
+            fassert(game->initial_reset_complete);
+            if (threads.size() == 0) {
+                run_rollout(game.get());
+                if (batch_size > 0) {
+                    ready_queue.push(e);
+                }
+            } else {
+                game->is_waiting_for_step = true;
+                if (!static_partition) {
+                    pending_games_for(e).push_back(game);
+                }
+            }
+        }
+
+        if (static_partition && threads.size() > 0) {
+            batch_generation++;
+        }
+    }
+
+    notify_work_added();
+    wait_for_stepping_threads();
+
+    std::unique_lock<std::mutex> lock(stepping_thread_mutex);
+    rollout_job = nullptr;
+}
+
+void VecGame::run_rollout(Game *game) {
+    const RolloutJob &job = *rollout_job;
+    const struct libenv_buffers *bufs = job.bufs;
+    int e = game->game_n;
+
+    // the per step buffers replace the libenv buffers of the game until the rollout is done
+    auto obs_bufs = game->obs_bufs;
+    auto info_bufs = game->info_bufs;
+    float *reward_ptr = game->reward_ptr;
+    uint8_t *first_ptr = game->first_ptr;
+
+    RandGen policy_rand_gen;
+    if (job.policy == RolloutPolicyRandom) {
+        policy_rand_gen.seed(job.policy_seeds[e]);
+    }
+
+    for (int t = 0; t < job.num_steps; t++) {
+        size_t slot = (size_t)(t) * num_envs + e;
+        int32_t *ac = bufs->ac != nullptr && bufs->ac[0] != nullptr ? (int32_t *)(bufs->ac[0]) + slot : nullptr;
+
+        if (job.policy == RolloutPolicyRandom) {
+            game->action = policy_rand_gen.randn(num_actions);
+        } else if (job.policy == RolloutPolicyConstant) {
+            game->action = *game->action_ptr;
+        } else {
+            game->action = *ac;
+        }
+
+        if (ac != nullptr) {
+            *ac = game->action;
+        }
+
+        for (size_t i = 0; i < obs_bufs.size(); i++) {
+            game->obs_bufs[i] = (uint8_t *)(bufs->ob[i]) + slot * job.ob_sizes[i];
+        }
+        for (size_t i = 0; i < info_bufs.size(); i++) {
+            game->info_bufs[i] = (uint8_t *)(bufs->info[i]) + slot * job.info_sizes[i];
+        }
+        game->reward_ptr = bufs->rew + slot;
+        game->first_ptr = bufs->first + slot;
+
+        game->step();
+    }
+
+    game->obs_bufs = obs_bufs;
+    game->info_bufs = info_bufs;
+    game->reward_ptr = reward_ptr;
+    game->first_ptr = first_ptr;
+    // leave the libenv buffers as if the last step had been done with act
+    game->observe();
+}
+
+int VecGame::replay(const std::string &path, const int32_t *render_steps, int count, uint8_t *out_obs) {
+    TraceThreadScope thread_trace(caller_trace_buffer());
+    TraceScope trace(caller_trace_buffer(), "replay");
+    fassert(recorder == nullptr && action_log == nullptr);
+
+    ActionLog log = read_action_log(path);
+    fassert(log.num_envs == num_envs);
+
+    // the out_obs slot of each step, or -1 if the step is not rendered
+    std::vector<int> render_slots(log.num_steps + 1, -1);
+    for (int i = 0; i < count; i++) {
+        fassert(render_steps[i] >= 0 && render_steps[i] <= log.num_steps);
+        fassert(i == 0 || render_steps[i] > render_steps[i - 1]);
+        render_slots[render_steps[i]] = i;
+    }
+
+    const size_t ob_size = RES_W * RES_H * 3;
+    auto copy_obs = [&](int slot) {
+        for (int e = 0; e < num_envs; e++) {
+            memcpy(out_obs + ((size_t)(slot) * num_envs + e) * ob_size, games[e]->obs_bufs[0], ob_size);
+        }
+    };
+
+    wait_for_stepping_threads();
+    // the initial observation was rendered when the buffers were set
+    if (render_slots[0] >= 0) {
+        copy_obs(render_slots[0]);
+    }
+
+    int step = 0;
+    for (const auto &entry : log.entries) {
+        if (entry.event == ActionLogAct) {
+            step++;
+            bool render = render_slots[step] >= 0;
+            // the previous step may still be running and reads render_enabled when it observes
+            wait_for_stepping_threads();
+            for (int e = 0; e < num_envs; e++) {
+                games[e]->render_enabled = render;
+                *games[e]->action_ptr = entry.actions[e];
+            }
+            act_envs(0, num_envs);
+            if (render) {
+                wait_for_stepping_threads();
+                copy_obs(render_slots[step]);
+            }
+        } else {
+            wait_for_stepping_threads();
+            const auto &game = games[entry.env_idx];
+            auto b = ReadBuffer((char *)(entry.data.data()), entry.data.size());
+            if (entry.event == ActionLogSetEnvironment) {
+                game->set_environment(&b);
+            } else {
+                game->deserialize(&b);
+                game->restore_derived_state();
+                // set_state renders the restored state, which is the observation of the current step
+                game->render_enabled = render_slots[step] >= 0;
+                game->thread_phase_stats = caller_phase_stats();
+                game->observe();
+                if (game->render_enabled) {
+                    copy_obs(render_slots[step]);
+                }
+            }
+            fassert(b.read_int() == END_OF_BUFFER);
+        }
+    }
+
+    wait_for_stepping_threads();
+    for (int e = 0; e < num_envs; e++) {
+        games[e]->render_enabled = true;
+    }
+
+    return log.num_steps;
+}
+
+void ReadyQueue::init(int num_envs) {
+    envs.clear();
+    is_queued.assign(num_envs, 0);
+}
+
+int ReadyQueue::size() {
+    return (int)(envs.size());
+}
+
+void ReadyQueue::push(int env_idx) {
+    fassert(!is_queued[env_idx]);
+    is_queued[env_idx] = 1;
+    envs.push_back(env_idx);
+}
+
+int ReadyQueue::pop() {
+    int env_idx = envs.front();
+    envs.pop_front();
+    is_queued[env_idx] = 0;
+    return env_idx;
+}
+
+void ReadyQueue::remove(const int32_t *env_ids, int count) {
+    bool any_queued = false;
+    for (int i = 0; i < count; i++) {
+        int e = env_ids[i];
+        if (e >= 0 && e < (int)(is_queued.size()) && is_queued[e]) {
+            is_queued[e] = 0;
+            any_queued = true;
+        }
+    }
+    if (any_queued) {
+        envs.erase(std::remove_if(envs.begin(), envs.end(), [this](int e) { return !is_queued[e]; }), envs.end());
+    }
+}
+
+void ReadyQueue::remove_range(int begin, int end) {
+    for (int e = begin; e < end; e++) {
+        is_queued[e] = 0;
+    }
+    envs.erase(std::remove_if(envs.begin(), envs.end(), [this](int e) { return !is_queued[e]; }), envs.end());
 }
 
 VecGame::~VecGame() {
@@ -406,23 +1094,45 @@ VecGame::~VecGame() {
         std::unique_lock<std::mutex> lock(stepping_thread_mutex);
         time_to_die = true;
     }
-    pending_games_added.notify_all();
+    notify_work_added();
 
     for (auto &t : threads) {
         t.join();
     }
+
+    // flushes the recorded steps
+    recorder.reset();
+    action_log.reset();
+
+    if (trace_path != "" && !write_trace(trace_path)) {
+        fprintf(stderr, "failed to write trace to %s\n", trace_path.c_str());
+    }
+}
+
+bool VecGame::write_trace(const std::string &path) {
+    fassert(tracing);
+    // the stepping threads only write to their buffers while they own a game
+    wait_for_stepping_threads();
+    return write_chrome_trace(path, trace_buffers, trace_epoch_ns);
 }
 
 void VecGame::wait_for_stepping_threads() {
+    wait_for_stepping_threads(0, num_envs);
+}
+
+void VecGame::wait_for_stepping_threads(int begin, int end) {
     if (threads.size() == 0) {
         return;
     }
 
+    TraceScope trace(caller_trace_buffer(), "wait_for_stepping_threads");
+
     std::unique_lock<std::mutex> lock(stepping_thread_mutex);
+    int64_t spin_deadline_ns = 0;
     while (1) {
         bool all_steps_completed = true;
 
-        for (int e = 0; e < num_envs; e++) {
+        for (int e = begin; e < end; e++) {
             const auto &game = games[e];
             all_steps_completed &= !game->is_waiting_for_step;
         }
@@ -430,7 +1140,9 @@ void VecGame::wait_for_stepping_threads() {
         if (all_steps_completed)
             break;
 
-        pending_game_complete.wait(lock);
+        if (!spin_wait(lock, completion_epoch, &spin_deadline_ns)) {
+            pending_game_complete.wait(lock);
+        }
     }
 }
 
@@ -447,19 +1159,108 @@ extern "C" {
     LIBENV_API void set_state(libenv_env *handle, int env_idx, char *data, int length) {
         auto venv = (VecGame *)(handle);
         venv->wait_for_stepping_threads();
+        TraceThreadScope thread_trace(venv->caller_trace_buffer());
         auto b = ReadBuffer(data, length);
         venv->games.at(env_idx)->deserialize(&b);
         fassert(b.read_int() == END_OF_BUFFER);
+        venv->games.at(env_idx)->restore_derived_state();
+        if (venv->action_log != nullptr) {
+            venv->action_log->write_env_data(ActionLogSetState, env_idx, data, length);
+        }
         // after deserializing, we need to update the observation and info buffers so that the
         // next time VecGame::observe() is called, the correct data will be in the buffers
+        venv->games.at(env_idx)->thread_phase_stats = venv->caller_phase_stats();
         venv->games.at(env_idx)->observe();
     }
 
+    // copies the accumulated phase timings of an env, or of a stepping thread if is_thread is set, to out
+    // out receives PHASE_STATS_VALUES int64 values, for each phase: total_ns, count and a log2 histogram
+    // returns the number of values written, or 0 if the phase_timing option is not set
+    LIBENV_API int get_phase_stats(libenv_env *handle, int is_thread, int idx, int64_t *out, int length) {
+        auto venv = (VecGame *)(handle);
+        venv->wait_for_stepping_threads();
+        if (!venv->phase_timing) {
+            return 0;
+        }
+        fassert(length >= PHASE_STATS_VALUES);
+        if (is_thread) {
+            venv->thread_phase_stats.at(idx).write(out);
+        } else {
+            venv->games.at(idx)->phase_stats->write(out);
+        }
+        return PHASE_STATS_VALUES;
+    }
+
+    // waits for the envs of a group to finish stepping, the other groups are not waited for
+    LIBENV_API void observe_group(libenv_env *handle, int group) {
+        auto venv = (VecGame *)(handle);
+        venv->observe_group(group);
+    }
+
+    // steps the envs of a group with the actions in their slice of the action buffer
+    LIBENV_API void act_group(libenv_env *handle, int group) {
+        auto venv = (VecGame *)(handle);
+        venv->act_group(group);
+    }
+
+    // waits until batch_size envs are ready and writes their ids to env_ids, returns the number of ids written
+    LIBENV_API int observe_ready(libenv_env *handle, int32_t *env_ids) {
+        auto venv = (VecGame *)(handle);
+        venv->observe_ready(env_ids);
+        return venv->batch_size;
+    }
+
+    // steps the given envs with the actions in their slots of the action buffer
+    LIBENV_API void act_ready(libenv_env *handle, const int32_t *env_ids, int count) {
+        auto venv = (VecGame *)(handle);
+        venv->act_ready(env_ids, count);
+    }
+
+    // runs num_steps steps of every env on the stepping threads, policy_kind is a RolloutPolicy
+    // each pointer of out_buffers points to an array of num_steps * num_envs entries for its space, laid
+    // out as [num_steps, num_envs, ...], the actions taken are written to out_buffers->ac[0] if it is set
+    LIBENV_API void libenv_rollout(libenv_env *handle, int num_steps, int policy_kind, int seed, struct libenv_buffers *out_buffers) {
+        auto venv = (VecGame *)(handle);
+        venv->rollout(num_steps, policy_kind, seed, out_buffers);
+    }
+
+    // replays the action log at path, see VecGame::replay, out_obs receives count * num_envs observations
+    LIBENV_API int replay(libenv_env *handle, const char *path, const int32_t *render_steps, int count, uint8_t *out_obs) {
+        auto venv = (VecGame *)(handle);
+        return venv->replay(path, render_steps, count, out_obs);
+    }
+
+    // writes the events recorded so far as chrome trace json to path, requires the tracing option
+    // returns 1 on success and 0 if the file could not be written
+    LIBENV_API int write_trace(libenv_env *handle, const char *path) {
+        auto venv = (VecGame *)(handle);
+        return venv->write_trace(path) ? 1 : 0;
+    }
+
+    // writes a comma separated list of registered game names to data, returns the length of the full list
+    LIBENV_API int get_game_names(char *data, int length) {
+        fassert(length >= 0);
+        std::string names;
+        for (const auto &entry : *globalGameRegistry) {
+            if (!names.empty()) {
+                names += ",";
+            }
+            names += entry.first;
+        }
+        if (data != nullptr) {
+            memcpy(data, names.c_str(), std::min((size_t)(length), names.size()));
+        }
+        return (int)(names.size());
+    }
+
     LIBENV_API void set_environment(libenv_env *handle, int env_idx, char *data, int length) {
         auto venv = (VecGame *)(handle);
         venv->wait_for_stepping_threads();
         auto b = ReadBuffer(data, length);
         venv->games.at(env_idx)->set_environment(&b);
         fassert(b.read_int() == END_OF_BUFFER);
+        if (venv->action_log != nullptr) {
+            venv->action_log->write_env_data(ActionLogSetEnvironment, env_idx, data, length);
+        }
     }
 }
\ No newline at end of file
@@ -13,10 +13,52 @@ This implements the libenv interface and manages a vector of Game instances
 #include <condition_variable>
 #include <thread>
 #include <list>
+#include <atomic>
+#include <deque>
+#include "phase-timer.h"
+#include "trace.h"
+#include "trajectory-recorder.h"
+#include "action-log.h"
 
 class VecOptions;
 class Game;
 
+// how libenv_rollout picks actions
+enum RolloutPolicy {
+    // uniformly random actions from a generator seeded per env
+    RolloutPolicyRandom = 0,
+    // each env repeats the action currently in its slot of the action buffer
+    RolloutPolicyConstant = 1,
+    // actions are read from the rollout action buffer
+    RolloutPolicyScripted = 2,
+};
+
+// the state of a libenv_rollout call, each buffer holds num_steps * num_envs entries
+struct RolloutJob {
+    int num_steps;
+    int policy;
+    const struct libenv_buffers *bufs;
+    std::vector<size_t> ob_sizes;
+    std::vector<size_t> info_sizes;
+    std::vector<int> policy_seeds;
+};
+
+// envs that finished stepping and have not yet been returned by observe_ready, in order of completion
+class ReadyQueue {
+  public:
+    void init(int num_envs);
+    int size();
+    void push(int env_idx);
+    int pop();
+    // removes any of the given envs that are in the queue
+    void remove(const int32_t *env_ids, int count);
+    void remove_range(int begin, int end);
+
+  private:
+    std::deque<int> envs;
+    std::vector<uint8_t> is_queued;
+};
+
 class VecGame {
   public:
     std::vector<struct libenv_tensortype> observation_types;
@@ -25,8 +67,12 @@ class VecGame {
 
     int num_envs;
     int num_joint_games;
+    // envs are split into this many equal contiguous groups that can be stepped independently
+    int num_groups;
     int num_actions;
     bool render_human;
+    bool phase_timing;
+    bool tracing;
 
     std::vector<std::shared_ptr<Game>> games;
 
@@ -38,15 +84,97 @@ class VecGame {
     void act();
     void wait_for_stepping_threads();
 
+    // like observe and act, but only for the envs of one group, the envs of other groups may still be stepping
+    void observe_group(int group);
+    void act_group(int group);
+    void get_group_range(int group, int *begin, int *end);
+
+    // number of envs returned by observe_ready, 0 if the partial batch mode is disabled
+    int batch_size;
+
+    // with partition_envs each stepping thread owns a contiguous range of envs, creates them and is
+    // the only thread that steps them, thread_affinity is an optional core list to pin the threads to
+    bool partition_envs;
+    // implies partition_envs, act on all envs starts one batch in which each stepping thread steps its
+    // whole env range without taking the lock per env
+    bool static_partition;
+    // the stepping threads and the calling thread spin for up to this long before sleeping on a condition variable
+    int spin_wait_us;
+    std::vector<int> thread_cores;
+    // waits until batch_size envs have finished stepping and writes their ids to env_ids, these envs
+    // are not returned again until they have been stepped with act_ready
+    void observe_ready(int32_t *env_ids);
+    // steps the given envs with the actions in their slots of the action buffer
+    void act_ready(const int32_t *env_ids, int count);
+
+    // steps every env num_steps times on the stepping threads without returning to the caller, the
+    // observations, rewards, firsts, infos and actions of each step are written to bufs
+    void rollout(int num_steps, int policy, int seed, const struct libenv_buffers *bufs);
+
+    // records the options, actions and set_environment and set_state calls when created with an action_log_path
+    std::unique_ptr<ActionLogWriter> action_log;
+
+    // replays an action log on this VecGame, which must be new and created with the options of the log,
+    // rendering only the observations of render_steps, which must be increasing, step 0 is the initial
+    // observation and step k the one after the k-th act, the observations of every env are written to
+    // out_obs for each of these steps, returns the number of steps in the log
+    int replay(const std::string &path, const int32_t *render_steps, int count, uint8_t *out_obs);
+
+    // one entry per stepping thread, or a single entry when stepping on the calling thread
+    std::vector<PhaseStats> thread_phase_stats;
+    // the stats of the calling thread, null unless phase_timing is set and there are no stepping threads
+    PhaseStats *caller_phase_stats();
+
+    // the first entry is the calling thread, followed by one entry per stepping thread
+    std::vector<std::unique_ptr<TraceBuffer>> trace_buffers;
+    // the buffer of the calling thread, null unless tracing is enabled
+    TraceBuffer *caller_trace_buffer();
+
+    // writes the events recorded so far as chrome trace json, returns false if the file could not be written
+    bool write_trace(const std::string &path);
+
   private:
     // this mutex synchronizes access to pending_games and game->is_waiting_for_step
     // when game->is_waiting_for_step is set to true
     // ownership of game objects is transferred to the stepping thread until
     // game->is_waiting_for_step is set to false
     std::mutex stepping_thread_mutex;
-    std::list<std::shared_ptr<Game>> pending_games;
+    // a single list shared by all stepping threads, or one list per thread with partition_envs
+    std::vector<std::list<std::shared_ptr<Game>>> pending_games;
+    std::vector<int> env_thread;
+    // incremented to start a batch with static_partition
+    int64_t batch_generation = 0;
+
+    // incremented whenever games are queued or a batch is started, and whenever games complete, to end spins
+    std::atomic<uint64_t> work_epoch;
+    std::atomic<uint64_t> completion_epoch;
+
+    void notify_work_added();
+    void notify_game_complete();
+    bool spin_wait(std::unique_lock<std::mutex> &lock, const std::atomic<uint64_t> &epoch, int64_t *spin_deadline_ns);
+
+    // records the steps taken with observe and act when created with a record_path
+    std::unique_ptr<TrajectoryRecorder> recorder;
+
+    // only set during rollout
+    RolloutJob *rollout_job = nullptr;
+    void run_rollout(Game *game);
+
+    void stepping_worker(int thread_idx);
+    void step_game(const std::shared_ptr<Game> &game, int thread_idx);
+    void get_thread_range(int thread_idx, int *begin, int *end);
     std::condition_variable pending_games_added;
     std::condition_variable pending_game_complete;
     std::vector<std::thread> threads;
     bool time_to_die = false;
+    // only used when batch_size is set, guarded by stepping_thread_mutex
+    ReadyQueue ready_queue;
+    // written on close if set
+    std::string trace_path;
+    int64_t trace_epoch_ns = 0;
+
+    void observe_envs(int begin, int end);
+    void act_envs(int begin, int end);
+    void wait_for_stepping_threads(int begin, int end);
+    std::list<std::shared_ptr<Game>> &pending_games_for(int env_idx);
 };
@@ -37,6 +37,10 @@ void VecOptions::ensure_empty() {
     }
 }
 
+const std::vector<libenv_option> &VecOptions::items() const {
+    return m_options;
+}
+
 libenv_option VecOptions::find_option(std::string name, enum libenv_dtype dtype) {
     for (size_t idx = 0; idx < m_options.size(); idx++) {
         auto opt = m_options[idx];
@@ -19,6 +19,8 @@ class VecOptions {
     void consume_int(std::string name, int32_t *value);
     void consume_bool(std::string name, bool *value);
     void ensure_empty();
+    // the options that have not been consumed yet
+    const std::vector<libenv_option> &items() const;
 
   private:
     std::vector<libenv_option> m_options;
@@ -0,0 +1,137 @@
+"""
+Reader for the trajectory files written by environments created with a record_path, see
+src/trajectory-recorder.h for the format
+"""
+
+import numpy as np
+
+MAGIC = b"PGTRAJ01"
+CHUNK_MAGIC = 0x4B4E4843
+FILE_HEADER_SIZE = 64
+CHUNK_HEADER_SIZE = 32
+
+FILE_HEADER_DTYPE = np.dtype(
+    [
+        ("magic", "S8"),
+        ("version", "<i4"),
+        ("num_envs", "<i4"),
+        ("ob_shape", "<i4", (3,)),
+        ("block_size", "<i4"),
+        ("chunk_steps", "<i4"),
+        ("padding", "<i4", (7,)),
+    ]
+)
+
+CHUNK_HEADER_DTYPE = np.dtype(
+    [
+        ("magic", "<u4"),
+        ("num_steps", "<i4"),
+        ("chunk_size", "<u8"),
+        ("ob_data_size", "<u8"),
+        ("padding", "<u8"),
+    ]
+)
+
+
+def _align8(size):
+    return (size + 7) // 8 * 8
+
+
+class TrajectoryReader:
+    """
+    Memory maps a trajectory file, the actions, rewards and level seeds of a chunk are
+    returned as views of the file, the observations are decoded when a chunk is read
+
+    Each step holds the observation, reward, first and level_seed returned by observe() and the
+    action passed to the following act(), indexed by [step, env].  A chunk that was only partially
+    written, for instance because the process died, is ignored.
+    """
+
+    def __init__(self, path):
+        self._data = np.memmap(path, dtype=np.uint8, mode="r")
+        header = self._data[:FILE_HEADER_SIZE].view(FILE_HEADER_DTYPE)[0]
+        assert header["magic"] == MAGIC, f"{path} is not a trajectory file"
+        assert header["version"] == 1, f"unsupported trajectory version {header['version']}"
+        assert header["block_size"] == 8
+        self.num_envs = int(header["num_envs"])
+        self.ob_shape = tuple(int(x) for x in header["ob_shape"])
+
+        self._chunks = []
+        offset = FILE_HEADER_SIZE
+        while offset + CHUNK_HEADER_SIZE <= len(self._data):
+            chunk = self._data[offset : offset + CHUNK_HEADER_SIZE].view(CHUNK_HEADER_DTYPE)[0]
+            if chunk["magic"] != CHUNK_MAGIC or offset + int(chunk["chunk_size"]) > len(self._data):
+                break
+            self._chunks.append((offset, int(chunk["num_steps"])))
+            offset += int(chunk["chunk_size"])
+
+        self.num_steps = sum(num_steps for _, num_steps in self._chunks)
+
+    @property
+    def num_chunks(self):
+        return len(self._chunks)
+
+    def read_chunk(self, idx):
+        """
+        Returns a dict of arrays indexed by [step, env] with the keys action, reward, level_seed,
+        first and rgb
+        """
+        offset, num_steps = self._chunks[idx]
+        offset += CHUNK_HEADER_SIZE
+        shape = (num_steps, self.num_envs)
+        count = num_steps * self.num_envs
+
+        result = {}
+        for name, dtype in [("action", "<i4"), ("reward", "<f4"), ("level_seed", "<i4"), ("first", "u1"), ("ob_offsets", "<u8")]:
+            dtype = np.dtype(dtype)
+            n = count + 1 if name == "ob_offsets" else count
+            size = n * dtype.itemsize
+            result[name] = self._data[offset : offset + size].view(dtype)
+            offset += _align8(size)
+
+        ob_offsets = result.pop("ob_offsets")
+        for name in result:
+            result[name] = result[name].reshape(shape)
+        result["first"] = result["first"].astype(bool)
+        result["rgb"] = self._decode_obs(self._data[offset : offset + int(ob_offsets[-1])], ob_offsets, num_steps)
+        return result
+
+    def read(self):
+        """
+        Returns the whole trajectory like read_chunk, with the chunks concatenated along the step axis
+        """
+        chunks = [self.read_chunk(i) for i in range(self.num_chunks)]
+        if len(chunks) == 0:
+            chunks = [self._empty_chunk()]
+        return {k: np.concatenate([c[k] for c in chunks]) for k in chunks[0]}
+
+    def _decode_obs(self, ob_data, ob_offsets, num_steps):
+        ob_size = int(np.prod(self.ob_shape))
+        num_blocks = (ob_size + 7) // 8
+        mask_size = _align8((num_blocks + 7) // 8)
+
+        # blocks are compared as whole 8 byte words, the last one is zero padded
+        blocks = np.zeros((num_steps, self.num_envs, num_blocks), dtype=np.uint64)
+        for e in range(self.num_envs):
+            prev = np.zeros(num_blocks, dtype=np.uint64)
+            for t in range(num_steps):
+                i = t * self.num_envs + e
+                encoded = ob_data[int(ob_offsets[i]) : int(ob_offsets[i + 1])]
+                mask = np.unpackbits(encoded[:mask_size], bitorder="little")[:num_blocks].astype(bool)
+                cur = prev.copy()
+                cur[mask] = encoded[mask_size:].view("<u8")
+                blocks[t, e] = cur
+                prev = cur
+
+        obs = blocks.view(np.uint8).reshape(num_steps, self.num_envs, num_blocks * 8)[:, :, :ob_size]
+        return obs.reshape((num_steps, self.num_envs) + self.ob_shape)
+
+    def _empty_chunk(self):
+        shape = (0, self.num_envs)
+        return {
+            "action": np.zeros(shape, dtype=np.int32),
+            "reward": np.zeros(shape, dtype=np.float32),
+            "level_seed": np.zeros(shape, dtype=np.int32),
+            "first": np.zeros(shape, dtype=bool),
+            "rgb": np.zeros(shape + self.ob_shape, dtype=np.uint8),
+        }